@@ -24,9 +24,13 @@
 
 #include "glpenv.h"
 
-static void *tls = NULL;
+#ifndef TLS
+#define TLS
+#endif
+static TLS void *tls = NULL;
 /* in a re-entrant version of the package this variable must be placed
-   in the Thread Local Storage (TLS) */
+   in the Thread Local Storage (TLS); define TLS as the compiler's
+   thread-local storage class specifier (e.g. __thread) for that */
 
 /***********************************************************************
 *  NAME
@@ -22,6 +22,7 @@
 #include <string>
 #include <cassert>
 #include <cstdlib>
+#include <unistd.h>
 
 #include <vector>
 #include <lemon/lp.h>
@@ -30,6 +31,13 @@
 
 #include "ezOptionParser.hpp"
 #include "mflib/MFGraph.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFBamReadSource.hpp"
+#include "mflib/MFPipelinedReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include "mflib/MFRegionIndex.hpp"
+#include "mflib/MFContigRunner.hpp"
+#include "mflib/MFComponentRunner.hpp"
 
 using namespace methylFlow;
 using namespace ez;
@@ -40,6 +48,14 @@ void Usage(ezOptionParser & opt) {
     std::cout << usage << std::endl;
 };
 
+// read allocations of each component, with -arena-stats
+void print_component_stats(const int componentID, const MFArenaStats &stats, void *)
+{
+    std::cout << "[methylFlow] Component " << componentID << " read allocations " << stats.allocations
+              << ", " << stats.bytes / 1024 << " KB, chunks allocated " << stats.chunks_allocated
+              << ", released " << stats.chunks_released << std::endl;
+}
+
 //The main entry point
 // assume arguments:
 //   input file
@@ -112,6 +128,50 @@ int main(int argc, const char **argv)
             "--sam" //flag token
             );
     
+    // BAM file input
+    opt.add(
+            "", // Default.
+            0, // Required (for now, will switch to stdin if missing in future)
+            0, // number of args expected
+            0, // delimiter, not needed
+            "BAM input file. Binary SAM with methylation calls in the XM tag (e.g. Bismark)", // Help description
+            "-bam", // flag token
+            "-BAM", // flag token
+            "--bam" //flag token
+            );
+    
+    // binary read file input
+    opt.add(
+            "", // Default.
+            0, // Required (for now, will switch to stdin if missing in future)
+            0, // number of args expected
+            0, // delimiter, not needed
+            "mfr input file. Binary reads written by mfrConvert, carries chr numbers", // Help description
+            "-mfr", // flag token
+            "--mfr" //flag token
+            );
+    
+    // region queries, need an index written by mfIndex
+    opt.add(
+            "", // Default.
+            0, // Not required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Only use reads overlapping region chr:start-end (1-based, inclusive). Needs input file index (mfIndex)", // Help description
+            "-region", // flag token
+            "--region" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // Not required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Only use reads overlapping regions in BED file. Needs input file index (mfIndex)", // Help description
+            "-regions", // flag token
+            "--regions" //flag token
+            );
+    
     
     const char * DEFAULT_OUTDIR = "mfoutput";
     // output directory
@@ -175,6 +235,86 @@ int main(int argc, const char **argv)
             "--eps"
             );
     
+    // lambda search
+    opt.add(
+            "", // default
+            0, // not required
+            0, // no args, it's a flag
+            0, // no delimiter
+            "Search lambda along the LP solution path for the exact largest value passing the -e threshold, rather than on a grid of powers of 2.", // help description
+            "-lambda-path", // flag tokens
+            "--lambda-path"
+            );
+    
+    // lambda search threads
+    MFSolverOptions DEFAULT_SOLVER_OPTIONS;
+    buffer.str("");
+    buffer << DEFAULT_SOLVER_OPTIONS.lambda_threads;
+    opt.add(
+            buffer.str().c_str(), // default
+            0, // not required, uses default
+            1, // num args
+            0, // no delimiter
+            "Number of threads splitting the lambda search of each large component, each solving its own copy of the LP.", // help description
+            "-lambda-threads", // flag tokens
+            "--lambda-threads"
+            );
+    
+    buffer.str("");
+    buffer << DEFAULT_SOLVER_OPTIONS.lambda_threads_min_nodes;
+    opt.add(
+            buffer.str().c_str(), // default
+            0, // not required, uses default
+            1, // num args
+            0, // no delimiter
+            "Nodes a component needs for its lambda search to be split across --lambda-threads.", // help description
+            "-lambda-min-nodes", // flag tokens
+            "--lambda-min-nodes"
+            );
+    
+    // BGZF decompression threads
+    const int DEFAULT_IO_THREADS = 1;
+    buffer.str("");
+    buffer << DEFAULT_IO_THREADS;
+    opt.add(
+            buffer.str().c_str(), // default
+            0, // not required, uses default
+            1, // num args
+            0, // no delimiter
+            "Number of threads decompressing BAM input, blocks are read ahead and inflated in parallel when > 1.", // help description
+            "-io-threads", // flag tokens
+            "--io-threads"
+            );
+    
+    // contigs solved in parallel
+    const int DEFAULT_CONTIG_THREADS = 1;
+    buffer.str("");
+    buffer << DEFAULT_CONTIG_THREADS;
+    opt.add(
+            buffer.str().c_str(), // default
+            0, // not required, uses default
+            1, // num args
+            0, // no delimiter
+            "Number of contigs solved in parallel, each with its own graph. When > 1 the reads of up to this many contigs are kept in memory at once, the one being read included.", // help description
+            "-contig-threads", // flag tokens
+            "--contig-threads"
+            );
+    
+    // components solved in parallel, one per hardware thread by default
+    const long ONLINE_CPUS = sysconf(_SC_NPROCESSORS_ONLN);
+    const int DEFAULT_THREADS = ONLINE_CPUS > 0 ? (int) ONLINE_CPUS : 1;
+    buffer.str("");
+    buffer << DEFAULT_THREADS;
+    opt.add(
+            buffer.str().c_str(), // default
+            0, // not required, uses default
+            1, // num args
+            0, // no delimiter
+            "Number of threads solving components, output is written in component order. Ignored when --contig-threads > 1.", // help description
+            "-threads", // flag tokens
+            "--threads"
+            );
+    
     // verbose option
     const bool DEFAULT_VERBOSE = true;
     buffer.str("");
@@ -190,6 +330,17 @@ int main(int argc, const char **argv)
             "--verbose"
             );
     
+    // read arena statistics
+    opt.add(
+            "", // default
+            0, // not required
+            0, // no args, it's a flag
+            0, // no delimiter
+            "Print the read allocations of each component. Ignored when --contig-threads > 1.", // help description
+            "-arena-stats", // flag tokens
+            "--arena-stats"
+            );
+    
     opt.parse(argc, argv);
     
     if (opt.isSet("-h")) {
@@ -214,20 +365,78 @@ int main(int argc, const char **argv)
         return 1;
     }
     
+    bool flag_SAM = false;
+    if (opt.isSet("-sam")) {
+        flag_SAM = true;
+    }
+    
+    bool flag_BAM = false;
+    if (opt.isSet("-bam")) {
+        flag_BAM = true;
+    }
+    
+    bool flag_MFR = false;
+    if (opt.isSet("-mfr")) {
+        flag_MFR = true;
+    }
+    
     int status = 0;
-    std::istream* instream;
+    std::istream* instream = &std::cin;
     std::string input_filename;
     std::ifstream input;
-    if (opt.isSet("-i")) {
+    MFMappedTSVReadSource mapped_source;
+    MFBamReadSource bam_source;
+    MFMfrReadSource mfr_source;
+    bool use_mapped = false;
+    int io_threads = DEFAULT_IO_THREADS;
+    if (opt.isSet("-io-threads")) {
+        opt.get("-io-threads")->getInt(io_threads);
+    }
+    int contig_threads = DEFAULT_CONTIG_THREADS;
+    if (opt.isSet("-contig-threads")) {
+        opt.get("-contig-threads")->getInt(contig_threads);
+    }
+    int threads = DEFAULT_THREADS;
+    if (opt.isSet("-threads")) {
+        opt.get("-threads")->getInt(threads);
+    }
+    MFSolverOptions solver_options;
+    if (opt.isSet("-lambda-path")) {
+        solver_options.lambda_search = LAMBDA_PATH;
+    }
+    if (opt.isSet("-lambda-threads")) {
+        opt.get("-lambda-threads")->getInt(solver_options.lambda_threads);
+    }
+    if (opt.isSet("-lambda-min-nodes")) {
+        opt.get("-lambda-min-nodes")->getInt(solver_options.lambda_threads_min_nodes);
+    }
+    
+    if (flag_BAM) {
+        if (opt.isSet("-i")) {
+            opt.get("-i")->getString(input_filename);
+        } else {
+            input_filename = "-";
+        }
+        if (bam_source.open(input_filename, io_threads) != 0) status = -1;
+    } else if (flag_MFR) {
+        // mfr files are memory-mapped, there is no stdin input
+        if (opt.isSet("-i")) {
+            opt.get("-i")->getString(input_filename);
+        }
+        if (mfr_source.open(input_filename) != 0) status = -1;
+    } else if (opt.isSet("-i")) {
         opt.get("-i")->getString(input_filename);
-        input.open( input_filename.c_str() );
-        instream = &input;
-        if (!instream) status = -1;
-    }else{
-        instream = &std::cin;
+        // tsv files are memory-mapped, anything else is streamed
+        if (!flag_SAM && mapped_source.open(input_filename) == 0) {
+            use_mapped = true;
+        } else {
+            input.open( input_filename.c_str() );
+            instream = &input;
+            if (!input) status = -1;
+        }
     }
     
-    int chr;
+    int chr = 0;
     if (opt.isSet("-chr")) {
         opt.get("-chr")->getInt(chr);
     }
@@ -263,11 +472,6 @@ int main(int argc, const char **argv)
         return -1;
     }
     
-    bool flag_SAM = false;
-    if (opt.isSet("-sam")) {
-        flag_SAM = true;
-    }
-    
     float lambda;
     if (opt.isSet("-l")) {
         opt.get("-l")->getFloat(lambda);
@@ -296,17 +500,99 @@ int main(int argc, const char **argv)
         verbose = DEFAULT_VERBOSE;
     }
     
-    MFGraph g;
-    status = g.run( *instream,
-                   comp_stream,
-                   pattern_stream,
-                   region_stream,
-                   chr,
-                   flag_SAM,
-                   lambda,
-                   scale_mult,
-                   epsilon,
-                   verbose );
+    MFStreamReadSource stream_source(*instream, flag_SAM);
+    MFReadSource *source = &stream_source;
+    if (flag_BAM) {
+        source = &bam_source;
+    } else if (flag_MFR) {
+        source = &mfr_source;
+    } else if (use_mapped) {
+        source = &mapped_source;
+    }
+    
+    // seek to the requested regions with the index next to the input file
+    std::vector<MFRegion> regions;
+    if (opt.isSet("-region")) {
+        std::string region_text;
+        opt.get("-region")->getString(region_text);
+        MFRegion region;
+        if (parse_region(region_text, region) != 0) {
+            std::cerr << "[methylFlow] Error parsing region " << region_text << std::endl;
+            return -1;
+        }
+        regions.push_back(region);
+    }
+    if (opt.isSet("-regions")) {
+        std::string bed_filename;
+        opt.get("-regions")->getString(bed_filename);
+        if (read_bed_regions(bed_filename, regions) != 0) {
+            std::cerr << "[methylFlow] Error reading regions file " << bed_filename << std::endl;
+            return -1;
+        }
+    }
+    
+    MFRegionIndex region_index;
+    MFRegionReadSource *region_source = NULL;
+    if (opt.isSet("-region") || opt.isSet("-regions")) {
+        if (flag_BAM || input_filename.empty()) {
+            std::cerr << "[methylFlow] Region queries need a tsv, sam or mfr input file" << std::endl;
+            return -1;
+        }
+        if (region_index.load(input_filename + ".mfi") != 0) {
+            std::cerr << "[methylFlow] Error loading index " << input_filename << ".mfi, run mfIndex first" << std::endl;
+            return -1;
+        }
+        region_source = new MFRegionReadSource(*source, region_index, regions);
+        source = region_source;
+    }
+    
+    int ncomponents = 0;
+    int nclosed_form = 0;
+    {
+        // parse on a separate thread while components are solved
+        MFPipelinedReadSource pipelined_source(*source);
+        
+        if (contig_threads > 1) {
+            MFContigRunner runner(contig_threads);
+            runner.set_solver_options(solver_options);
+            status = runner.run( pipelined_source,
+                                comp_stream,
+                                pattern_stream,
+                                region_stream,
+                                chr,
+                                flag_SAM || flag_BAM || flag_MFR,
+                                lambda,
+                                scale_mult,
+                                epsilon,
+                                verbose );
+            ncomponents = runner.component_count();
+            nclosed_form = runner.closed_form_count();
+        } else {
+            MFComponentRunner runner(threads);
+            runner.set_solver_options(solver_options);
+            if (opt.isSet("-arena-stats")) {
+                runner.set_stats_hook(print_component_stats, NULL);
+            }
+            status = runner.run( pipelined_source,
+                                comp_stream,
+                                pattern_stream,
+                                region_stream,
+                                chr,
+                                flag_SAM || flag_BAM || flag_MFR,
+                                lambda,
+                                scale_mult,
+                                epsilon,
+                                verbose );
+            ncomponents = runner.component_count();
+            nclosed_form = runner.closed_form_count();
+        }
+    }
+    // the parser thread is done with region_source
+    delete region_source;
+    
+    if (verbose) {
+        std::cout << "[methylFlow] " << nclosed_form << " of " << ncomponents << " components solved in closed form" << std::endl;
+    }
     
     // streams are closed when object
     // is destroyed
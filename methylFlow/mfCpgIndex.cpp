@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ezOptionParser.hpp"
+#include "mflib/MFCpgIndex.hpp"
+
+using namespace methylFlow;
+using namespace ez;
+
+void Usage(ezOptionParser & opt) {
+    std::string usage;
+    opt.getUsage(usage);
+    std::cout << usage << std::endl;
+};
+
+// writes the sorted CpG sites of a reference FASTA, read by
+// MFCpgIndex and the simulator
+int main(int argc, const char **argv)
+{
+    ezOptionParser opt;
+    opt.overview = "mfCpgIndex: index CpG sites of a reference";
+    opt.syntax = "mfCpgIndex -f reference.fa [OPTIONS]";
+    opt.example = "mfCpgIndex -f hg19.fa -o hg19.mfc";
+
+    opt.add(
+            "", //Default
+            0, // not required
+            0, // no args expected
+            0, // no delimiter
+            "Display usage instructions.", // help description
+            "-h", // flag tokens
+            "-help",
+            "--help",
+            "--usage"
+            );
+
+    opt.add(
+            "", // Default.
+            1, // Required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Reference FASTA file", // Help description
+            "-f", //flag token
+            "-fasta", // flag token
+            "--fasta" //flag token
+            );
+
+    opt.add(
+            "", // Default.
+            0, // not required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Index file, the FASTA file name with .mfc appended if not given", // Help description
+            "-o", //flag token
+            "-out", // flag token
+            "--out", // flag token
+            "--output" //flag token
+            );
+
+    opt.parse(argc, argv);
+
+    if (opt.isSet("-h")) {
+        Usage(opt);
+        return 1;
+    }
+
+    std::vector<std::string> badOptions;
+    if (!opt.gotRequired(badOptions)) {
+        for (std::size_t i = 0; i < badOptions.size(); ++i)
+            std::cerr << "ERROR: Missing required for option " << badOptions[i] << ".\n\n";
+        Usage(opt);
+        return 1;
+    }
+
+    std::string fasta_filename;
+    opt.get("-f")->getString(fasta_filename);
+
+    std::string index_filename = fasta_filename + ".mfc";
+    if (opt.isSet("-o")) {
+        opt.get("-o")->getString(index_filename);
+    }
+
+    if (MFCpgIndex::build(fasta_filename, index_filename) != 0) {
+        std::cerr << "[methylFlow] Error indexing " << fasta_filename << std::endl;
+        return -1;
+    }
+
+    MFCpgIndex index;
+    if (index.open(index_filename) != 0) {
+        std::cerr << "[methylFlow] Error reading " << index_filename << std::endl;
+        return -1;
+    }
+    std::cout << "[methylFlow] Wrote index " << index_filename << ": " << index.ncpgs()
+              << " CpGs on " << index.contigs().size() << " contigs" << std::endl;
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ezOptionParser.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include "mflib/MFRegionIndex.hpp"
+
+using namespace methylFlow;
+using namespace ez;
+
+void Usage(ezOptionParser & opt) {
+    std::string usage;
+    opt.getUsage(usage);
+    std::cout << usage << std::endl;
+};
+
+// writes the region index used by methylFlow -region/-regions
+// to the input file name with .mfi appended
+int main(int argc, const char **argv)
+{
+    ezOptionParser opt;
+    opt.overview = "mfIndex: index sorted reads for region queries";
+    opt.syntax = "mfIndex -i reads.tsv [OPTIONS]";
+    opt.example = "mfIndex -sam -i reads.sam\nmethylFlow -sam -i reads.sam -region chr1:10000-20000";
+    
+    opt.add(
+            "", //Default
+            0, // not required
+            0, // no args expected
+            0, // no delimiter
+            "Display usage instructions.", // help description
+            "-h", // flag tokens
+            "-help",
+            "--help",
+            "--usage"
+            );
+    
+    opt.add(
+            "", // Default.
+            1, // Required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Read input file sorted by position, tab-separated format unless -sam or -mfr is given", // Help description
+            "-i", //flag token
+            "-in", // flag token
+            "--in", // flag token
+            "--input" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "chr number for tsv files, not required for sam or mfr input file", // Help description
+            "-chr", //flag token
+            "-Chr" // flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            0, // number of args expected
+            0, // delimiter, not needed
+            "SAM input file", // Help description
+            "-sam", // flag token
+            "-SAM", // flag token
+            "--sam" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            0, // number of args expected
+            0, // delimiter, not needed
+            "mfr input file", // Help description
+            "-mfr", // flag token
+            "--mfr" //flag token
+            );
+    
+    opt.parse(argc, argv);
+    
+    if (opt.isSet("-h")) {
+        Usage(opt);
+        return 1;
+    }
+    
+    std::vector<std::string> badOptions;
+    if (!opt.gotRequired(badOptions)) {
+        for (std::size_t i = 0; i < badOptions.size(); ++i)
+            std::cerr << "ERROR: Missing required for option " << badOptions[i] << ".\n\n";
+        Usage(opt);
+        return 1;
+    }
+    
+    const bool flag_SAM = opt.isSet("-sam");
+    const bool flag_MFR = opt.isSet("-mfr");
+    
+    std::string input_filename;
+    opt.get("-i")->getString(input_filename);
+    
+    int chr = 0;
+    if (opt.isSet("-chr")) {
+        opt.get("-chr")->getInt(chr);
+    }
+    
+    int status = 0;
+    std::ifstream input;
+    MFMappedTSVReadSource mapped_source;
+    MFMfrReadSource mfr_source;
+    MFStreamReadSource stream_source(input, true);
+    MFReadSource *source;
+    
+    if (flag_MFR) {
+        if (mfr_source.open(input_filename) != 0) status = -1;
+        source = &mfr_source;
+    } else if (flag_SAM) {
+        input.open( input_filename.c_str() );
+        if (!input) status = -1;
+        source = &stream_source;
+    } else {
+        if (mapped_source.open(input_filename) != 0) status = -1;
+        source = &mapped_source;
+    }
+    
+    if (status == -1) {
+        std::cerr << "[methylFlow] Error opening file." << std::endl;
+        return -1;
+    }
+    
+    MFRegionIndex index;
+    if (index.build(*source, chr) != 0) {
+        std::cerr << "[methylFlow] Error indexing " << input_filename << std::endl;
+        return -1;
+    }
+    
+    const std::string index_filename = input_filename + ".mfi";
+    if (index.save(index_filename) != 0) {
+        std::cerr << "[methylFlow] Error writing " << index_filename << std::endl;
+        return -1;
+    }
+    std::cout << "[methylFlow] Wrote index " << index_filename << std::endl;
+    return 0;
+}
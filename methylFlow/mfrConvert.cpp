@@ -0,0 +1,201 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ezOptionParser.hpp"
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFBamReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+
+using namespace methylFlow;
+using namespace ez;
+
+void Usage(ezOptionParser & opt) {
+    std::string usage;
+    opt.getUsage(usage);
+    std::cout << usage << std::endl;
+};
+
+// converts tsv, SAM or BAM reads to the binary mfr format
+// read by methylFlow -mfr
+int main(int argc, const char **argv)
+{
+    ezOptionParser opt;
+    opt.overview = "mfrConvert: convert reads to binary mfr format";
+    opt.syntax = "mfrConvert -i reads.tsv -o reads.mfr [OPTIONS]";
+    opt.example = "mfrConvert -sam -i reads.sam -o reads.mfr";
+    
+    opt.add(
+            "", //Default
+            0, // not required
+            0, // no args expected
+            0, // no delimiter
+            "Display usage instructions.", // help description
+            "-h", // flag tokens
+            "-help",
+            "--help",
+            "--usage"
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required, reads stdin
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Read input file, tab-separated format unless -sam or -bam is given", // Help description
+            "-i", //flag token
+            "-in", // flag token
+            "--in", // flag token
+            "--input" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            1, // Required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "Output mfr file", // Help description
+            "-o", //flag token
+            "-out", // flag token
+            "--out", // flag token
+            "--output" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            1, // number of args expected
+            0, // delimiter, not needed
+            "chr number for tsv files, not required for sam input file", // Help description
+            "-chr", //flag token
+            "-Chr" // flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            0, // number of args expected
+            0, // delimiter, not needed
+            "SAM input file", // Help description
+            "-sam", // flag token
+            "-SAM", // flag token
+            "--sam" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            0, // number of args expected
+            0, // delimiter, not needed
+            "BAM input file", // Help description
+            "-bam", // flag token
+            "-BAM", // flag token
+            "--bam" //flag token
+            );
+    
+    opt.add(
+            "", // Default.
+            0, // not required
+            0, // number of args expected
+            0, // delimiter, not needed
+            "Don't store read ids, region ids in regions.tsv will be empty", // Help description
+            "-no-ids", // flag token
+            "--no-ids" //flag token
+            );
+    
+    opt.parse(argc, argv);
+    
+    if (opt.isSet("-h")) {
+        Usage(opt);
+        return 1;
+    }
+    
+    std::vector<std::string> badOptions;
+    if (!opt.gotRequired(badOptions)) {
+        for (std::size_t i = 0; i < badOptions.size(); ++i)
+            std::cerr << "ERROR: Missing required for option " << badOptions[i] << ".\n\n";
+        Usage(opt);
+        return 1;
+    }
+    
+    const bool flag_SAM = opt.isSet("-sam");
+    const bool flag_BAM = opt.isSet("-bam");
+    
+    std::string input_filename = "-";
+    if (opt.isSet("-i")) {
+        opt.get("-i")->getString(input_filename);
+    }
+    
+    std::string output_filename;
+    opt.get("-o")->getString(output_filename);
+    
+    int chr = 0;
+    if (opt.isSet("-chr")) {
+        opt.get("-chr")->getInt(chr);
+    }
+    
+    int status = 0;
+    std::istream* instream = &std::cin;
+    std::ifstream input;
+    MFMappedTSVReadSource mapped_source;
+    MFBamReadSource bam_source;
+    MFStreamReadSource *stream_source = NULL;
+    MFReadSource *source;
+    
+    if (flag_BAM) {
+        if (bam_source.open(input_filename) != 0) status = -1;
+        source = &bam_source;
+    } else if (!flag_SAM && input_filename != "-" && mapped_source.open(input_filename) == 0) {
+        source = &mapped_source;
+    } else {
+        if (input_filename != "-") {
+            input.open( input_filename.c_str() );
+            instream = &input;
+            if (!input) status = -1;
+        }
+        stream_source = new MFStreamReadSource(*instream, flag_SAM);
+        source = stream_source;
+    }
+    
+    std::string readid;
+    long nreads = 0;
+    int res = -1;
+    MethylRead *m;
+    if (status == 0) {
+        // SAM contigs are known once the header was read with the first read
+        res = source->next(m, readid, chr);
+    }
+    
+    MFMfrWriter writer;
+    if (status == 0 && writer.open(output_filename, opt.isSet("-no-ids") ? 0 : MFR_READ_IDS, source->contigs()) != 0) status = -1;
+    
+    if (status == -1) {
+        std::cerr << "[methylFlow] Error opening file." << std::endl;
+        if (res > 0) delete m;
+        delete stream_source;
+        return -1;
+    }
+    
+    while (res > 0) {
+        if (writer.write(*m, readid, chr) != 0) {
+            res = -1;
+            delete m;
+            break;
+        }
+        delete m;
+        nreads++;
+        res = source->next(m, readid, chr);
+    }
+    
+    if (writer.close() != 0) res = -1;
+    delete stream_source;
+    
+    if (res < 0) {
+        std::cerr << "[methylFlow] Error converting reads after " << nreads << " reads" << std::endl;
+        return -1;
+    }
+    std::cout << "[methylFlow] Wrote " << nreads << " reads to " << output_filename << std::endl;
+    return 0;
+}
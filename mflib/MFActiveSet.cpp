@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <functional>
+
+#include "MFActiveSet.hpp"
+
+namespace methylFlow {
+
+    typedef std::pair<int, std::size_t> EndIndex;
+
+    MFActiveSet::MFActiveSet() : window(), head(0), nlive(0), ends()
+    {
+    }
+
+    void MFActiveSet::clear()
+    {
+        window.clear();
+        ends.clear();
+        head = 0;
+        nlive = 0;
+    }
+
+    MFActiveSet::Entry &MFActiveSet::push_back(const lemon::ListDigraph::Node node, MethylRead *read)
+    {
+        Entry entry;
+        entry.node = node;
+        entry.read = read;
+        entry.start = read->start();
+        entry.end = read->end();
+        entry.slot = -1;
+        window.push_back(entry);
+        nlive++;
+
+        ends.push_back(EndIndex(entry.end, window.size() - 1));
+        std::push_heap(ends.begin(), ends.end(), std::greater<EndIndex>());
+        return window.back();
+    }
+
+    void MFActiveSet::set_read(const std::size_t i, MethylRead *read)
+    {
+        // the earlier pair is skipped when it comes up
+        window[i].read = read;
+        window[i].end = read->end();
+        ends.push_back(EndIndex(window[i].end, i));
+        std::push_heap(ends.begin(), ends.end(), std::greater<EndIndex>());
+    }
+
+    void MFActiveSet::expire(const int pos, std::vector<Entry> &expired)
+    {
+        while (!ends.empty() && ends.front().first < pos) {
+            const EndIndex top = ends.front();
+            std::pop_heap(ends.begin(), ends.end(), std::greater<EndIndex>());
+            ends.pop_back();
+
+            Entry &entry = window[top.second];
+            if (entry.node == lemon::INVALID || entry.end != top.first) continue;
+            expired.push_back(entry);
+            entry.node = lemon::INVALID;
+            nlive--;
+        }
+
+        while (head < window.size() && window[head].node == lemon::INVALID) ++head;
+        // removed entries are at most half of the window, plus some slack
+        if (window.size() > 2 * nlive + 64) compact();
+    }
+
+    void MFActiveSet::compact()
+    {
+        std::size_t n = 0;
+        for (std::size_t i = head; i < window.size(); ++i) {
+            if (window[i].node != lemon::INVALID) window[n++] = window[i];
+        }
+        window.resize(n);
+        head = 0;
+
+        ends.clear();
+        for (std::size_t i = 0; i < n; ++i) ends.push_back(EndIndex(window[i].end, i));
+        std::make_heap(ends.begin(), ends.end(), std::greater<EndIndex>());
+    }
+
+    std::size_t MFActiveSet::upper_bound(const int pos) const
+    {
+        // removed entries keep their start, so the window stays sorted
+        std::size_t lo = head, hi = window.size();
+        while (lo < hi) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (window[mid].start > pos) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+} // namespace methylFlow
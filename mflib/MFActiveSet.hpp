@@ -0,0 +1,106 @@
+#include <vector>
+#include <cstddef>
+
+#include <lemon/list_graph.h>
+
+#include "MethylRead.hpp"
+
+#ifndef MFACTIVESET_H
+#define MFACTIVESET_H
+
+namespace methylFlow {
+
+    // nodes whose reads may still overlap the next read, used by
+    // MFGraph::processRead. reads come in start order, so the nodes are
+    // a window kept in one vector in start order. a node leaves once
+    // its read ends before the start of the next read: a min-heap on
+    // read ends finds those, their entries are marked removed and the
+    // window is compacted when most of it is removed
+    //
+    // entries are indexed from begin() to end(), some of them removed,
+    // indices stay valid until the next call to expire
+    class MFActiveSet {
+    public:
+        struct Entry {
+            lemon::ListDigraph::Node node; // INVALID once removed
+            MethylRead *read;
+            int start;
+            int end;
+            // reachability slot in MFGraph, -1 if it has none yet
+            int slot;
+        };
+
+        MFActiveSet();
+
+        void clear();
+        bool empty() const;
+        // number of nodes in the set
+        std::size_t size() const;
+
+        // add node, its read starts at or after those of all others
+        Entry &push_back(const lemon::ListDigraph::Node node, MethylRead *read);
+        // the read of entry i was replaced by read, with the same start
+        void set_read(const std::size_t i, MethylRead *read);
+
+        // remove the nodes whose reads end before pos, appending them
+        // to expired
+        void expire(const int pos, std::vector<Entry> &expired);
+
+        std::size_t begin() const;
+        std::size_t end() const;
+        bool removed(const std::size_t i) const;
+        Entry &operator[](const std::size_t i);
+        const Entry &operator[](const std::size_t i) const;
+
+        // first index in [begin(), end()) whose read starts after pos
+        std::size_t upper_bound(const int pos) const;
+
+    private:
+        void compact();
+
+        std::vector<Entry> window;
+        std::size_t head; // entries before head are removed
+        std::size_t nlive;
+        // (end, index) of entries, smallest end first. entries whose
+        // read was replaced have a stale pair with an earlier end
+        std::vector<std::pair<int, std::size_t> > ends;
+    };
+
+    inline bool MFActiveSet::empty() const
+    {
+        return nlive == 0;
+    }
+
+    inline std::size_t MFActiveSet::size() const
+    {
+        return nlive;
+    }
+
+    inline std::size_t MFActiveSet::begin() const
+    {
+        return head;
+    }
+
+    inline std::size_t MFActiveSet::end() const
+    {
+        return window.size();
+    }
+
+    inline bool MFActiveSet::removed(const std::size_t i) const
+    {
+        return window[i].node == lemon::INVALID;
+    }
+
+    inline MFActiveSet::Entry &MFActiveSet::operator[](const std::size_t i)
+    {
+        return window[i];
+    }
+
+    inline const MFActiveSet::Entry &MFActiveSet::operator[](const std::size_t i) const
+    {
+        return window[i];
+    }
+
+} // namespace methylFlow
+
+#endif // MFACTIVESET_H
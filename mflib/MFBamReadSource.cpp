@@ -0,0 +1,164 @@
+#include <iostream>
+#include <cstring>
+
+#include "MFBamReadSource.hpp"
+
+namespace methylFlow {
+
+    // fixed-size part of a BAM alignment record (after block_size)
+    static const std::size_t BAM_CORE_SIZE = 32;
+
+    // size of a single aux value of the given type, 0 if not fixed
+    static std::size_t aux_type_size(const char type)
+    {
+        switch (type) {
+            case 'A': case 'c': case 'C':
+                return 1;
+            case 's': case 'S':
+                return 2;
+            case 'i': case 'I': case 'f':
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
+    // find a Z-typed tag in the aux block, sets [value, value_end)
+    static bool find_aux_string(const char *aux, const char *end, const char *tag,
+                                const char *&value, const char *&value_end)
+    {
+        while (aux + 3 <= end) {
+            const char type = aux[2];
+            const char *p = aux + 3;
+            const char *next;
+
+            if (type == 'Z' || type == 'H') {
+                next = static_cast<const char *>(memchr(p, '\0', end - p));
+                if (!next) return false;
+                if (type == 'Z' && aux[0] == tag[0] && aux[1] == tag[1]) {
+                    value = p;
+                    value_end = next;
+                    return true;
+                }
+                next++;
+            } else if (type == 'B') {
+                if (p + 5 > end) return false;
+                std::size_t size = aux_type_size(p[0]);
+                if (size == 0) return false;
+                next = p + 5 + size * le_uint32(p + 1);
+            } else {
+                std::size_t size = aux_type_size(type);
+                if (size == 0) return false;
+                next = p + size;
+            }
+            aux = next;
+        }
+        return false;
+    }
+
+    MFBamReadSource::MFBamReadSource() : bgzf(), contig_dict(), record()
+    {
+    }
+
+    MFBamReadSource::~MFBamReadSource()
+    {
+    }
+
+    int MFBamReadSource::open(const std::string &filename, const int io_threads)
+    {
+        char buf[4];
+
+        contig_dict.clear();
+        if (bgzf.open(filename, io_threads)) return -1;
+
+        if (bgzf.read(buf, 4) != 4 || memcmp(buf, "BAM\1", 4) != 0) {
+            std::cerr << "[methylFlow] Error reading BAM header" << std::endl;
+            return -1;
+        }
+
+        // skip the SAM header text
+        if (bgzf.read(buf, 4) != 4) return -1;
+        int l_text = le_int32(buf);
+        if (l_text < 0) return -1;
+        record.resize(l_text);
+        if (l_text > 0 && bgzf.read(&record[0], l_text) != l_text) return -1;
+
+        if (bgzf.read(buf, 4) != 4) return -1;
+        int n_ref = le_int32(buf);
+        if (n_ref < 0) return -1;
+
+        for (int i = 0; i < n_ref; ++i) {
+            if (bgzf.read(buf, 4) != 4) return -1;
+            int l_name = le_int32(buf);
+            if (l_name <= 0) return -1;
+            record.resize(l_name);
+            if (bgzf.read(&record[0], l_name) != l_name) return -1;
+            if (bgzf.read(buf, 4) != 4) return -1;
+
+            // reference ids are header positions, as are contig ids
+            // unless a name is repeated
+            std::string name(&record[0], l_name - 1);
+            if (contig_dict.add(name, le_int32(buf)) != i) {
+                std::cerr << "[methylFlow] Duplicate reference " << name << " in BAM header" << std::endl;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int MFBamReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        char buf[4];
+
+        while (true) {
+            long n = bgzf.read(buf, 4);
+            if (n == 0) return 0;
+            if (n != 4) {
+                std::cerr << "[methylFlow] Error parsing BAM input" << std::endl;
+                return -1;
+            }
+
+            int block_size = le_int32(buf);
+            if (block_size < (int) BAM_CORE_SIZE) {
+                std::cerr << "[methylFlow] Error parsing BAM input" << std::endl;
+                return -1;
+            }
+            record.resize(block_size);
+            if (bgzf.read(&record[0], block_size) != block_size) {
+                std::cerr << "[methylFlow] Error parsing BAM input" << std::endl;
+                return -1;
+            }
+
+            const char *rec = &record[0];
+            const char *end = rec + block_size;
+            int refID = le_int32(rec);
+            int pos = le_int32(rec + 4);
+            std::size_t l_read_name = (unsigned char) rec[8];
+            std::size_t n_cigar_op = le_uint16(rec + 12);
+            int l_seq = le_int32(rec + 16);
+
+            const char *read_name = rec + BAM_CORE_SIZE;
+            const char *aux = read_name + l_read_name + 4 * n_cigar_op + (l_seq + 1) / 2 + l_seq;
+            if (l_seq < 0 || aux > end || refID >= (int) contig_dict.size()) {
+                std::cerr << "[methylFlow] Error parsing BAM input" << std::endl;
+                return -1;
+            }
+
+            // unmapped reads have no position to place them at
+            if (refID < 0) continue;
+
+            chr = refID;
+            readid.assign(read_name, l_read_name > 0 ? l_read_name - 1 : 0);
+
+            // BAM positions are 0-based
+            read = new MethylRead(pos + 1, l_seq);
+
+            const char *xm, *xm_end;
+            if (find_aux_string(aux, end, "XM", xm, xm_end)) {
+                read->parseXMtag(xm, xm_end);
+            }
+            return 1;
+        }
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,43 @@
+#include <string>
+#include <vector>
+
+#include "MFReadSource.hpp"
+#include "MFBgzf.hpp"
+
+#ifndef MFBAMREADSOURCE_H
+#define MFBAMREADSOURCE_H
+
+namespace methylFlow {
+
+    // decodes binary BAM records (e.g. from Bismark) into reads
+    // methylation calls are taken from the XM tag in the aux block
+    class MFBamReadSource : public MFReadSource {
+    public:
+        MFBamReadSource();
+        ~MFBamReadSource();
+
+        // open file and read the BAM header, "-" reads from stdin
+        // io_threads > 1 decompresses blocks in parallel (see MFBgzfReader)
+        // returns 0 on success
+        int open(const std::string &filename, const int io_threads = 1);
+
+        // chr is the reference id of the record
+        int next(MethylRead *&read, std::string &readid, int &chr);
+
+        // reference sequences in header order
+        const MFContigs *contigs() const;
+
+    private:
+        MFBgzfReader bgzf;
+        MFContigs contig_dict;
+        std::vector<char> record;
+    };
+
+    inline const MFContigs *MFBamReadSource::contigs() const
+    {
+        return &contig_dict;
+    }
+
+} // namespace methylFlow
+
+#endif // MFBAMREADSOURCE_H
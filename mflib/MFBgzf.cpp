@@ -0,0 +1,388 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include <pthread.h>
+#include <zlib/zlib.h>
+
+#include "MFBgzf.hpp"
+
+namespace methylFlow {
+
+    // gzip member header up to and including XLEN
+    static const std::size_t BGZF_HEADER_SIZE = 12;
+    // CRC32 and ISIZE
+    static const std::size_t BGZF_FOOTER_SIZE = 8;
+
+    // find the BSIZE field among the gzip extra subfields
+    // returns total block size or -1 if this is not a BGZF block
+    static int bgzf_block_size(const char *header, const char *extra, const std::size_t xlen)
+    {
+        const unsigned char *h = reinterpret_cast<const unsigned char *>(header);
+        if (h[0] != 31 || h[1] != 139 || h[2] != 8 || !(h[3] & 4)) return -1;
+
+        std::size_t pos = 0;
+        while (pos + 4 <= xlen) {
+            std::size_t slen = le_uint16(extra + pos + 2);
+            if (extra[pos] == 'B' && extra[pos + 1] == 'C' && slen == 2 && pos + 6 <= xlen) {
+                return le_uint16(extra + pos + 4) + 1;
+            }
+            pos += 4 + slen;
+        }
+        return -1;
+    }
+
+    MFBgzfInflater::MFBgzfInflater() : zs(new z_stream)
+    {
+        memset(zs, 0, sizeof(z_stream));
+        if (inflateInit2(zs, -15) != Z_OK) {
+            delete zs;
+            zs = NULL;
+        }
+    }
+
+    MFBgzfInflater::~MFBgzfInflater()
+    {
+        if (zs) {
+            inflateEnd(zs);
+            delete zs;
+        }
+    }
+
+    int MFBgzfInflater::decompress(const char *block, const std::size_t block_size, char *out)
+    {
+        if (!zs || block_size < BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE) return -1;
+
+        std::size_t xlen = le_uint16(block + 10);
+        if (BGZF_HEADER_SIZE + xlen + BGZF_FOOTER_SIZE > block_size) return -1;
+
+        const char *footer = block + block_size - BGZF_FOOTER_SIZE;
+        unsigned int crc = le_uint32(footer);
+        unsigned int isize = le_uint32(footer + 4);
+        if (isize > BGZF_MAX_BLOCK_SIZE) return -1;
+
+        if (inflateReset(zs) != Z_OK) return -1;
+        zs->next_in = (Bytef *) (block + BGZF_HEADER_SIZE + xlen);
+        zs->avail_in = footer - (block + BGZF_HEADER_SIZE + xlen);
+        zs->next_out = (Bytef *) out;
+        zs->avail_out = BGZF_MAX_BLOCK_SIZE;
+
+        if (inflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out != isize) return -1;
+        if (crc32(crc32(0L, Z_NULL, 0), (const Bytef *) out, isize) != crc) return -1;
+        return isize;
+    }
+
+    // read the next compressed block from fp into block
+    // returns its size, 0 at end of file and -1 on error
+    static int read_block(std::FILE *fp, std::vector<char> &block)
+    {
+        char *buf = &block[0];
+        std::size_t n = fread(buf, 1, BGZF_HEADER_SIZE, fp);
+        if (n == 0 && feof(fp)) return 0;
+        if (n != BGZF_HEADER_SIZE) return -1;
+
+        std::size_t xlen = le_uint16(buf + 10);
+        if (BGZF_HEADER_SIZE + xlen > block.size()) return -1;
+        if (fread(buf + BGZF_HEADER_SIZE, 1, xlen, fp) != xlen) return -1;
+
+        int block_size = bgzf_block_size(buf, buf + BGZF_HEADER_SIZE, xlen);
+        if (block_size < 0 || (std::size_t) block_size > block.size() ||
+            (std::size_t) block_size < BGZF_HEADER_SIZE + xlen + BGZF_FOOTER_SIZE) {
+            return -1;
+        }
+
+        std::size_t remaining = block_size - BGZF_HEADER_SIZE - xlen;
+        if (fread(buf + BGZF_HEADER_SIZE + xlen, 1, remaining, fp) != remaining) return -1;
+        return block_size;
+    }
+
+    // read-ahead and parallel inflate of BGZF blocks
+    // a reader thread fills a ring of slots with compressed blocks in
+    // file order, workers inflate them in any order and next() hands
+    // them back in file order
+    class MFBgzfPool {
+    public:
+        MFBgzfPool(std::FILE *fp, const int nthreads);
+        ~MFBgzfPool();
+
+        // start threads, returns 0 on success
+        int start();
+
+        // wait for the next block in file order, returns 1 and sets
+        // data/length, 0 at end of file or -1 on error. data stays
+        // valid until the next call
+        int next(const char *&data, std::size_t &length);
+
+    private:
+        MFBgzfPool(const MFBgzfPool &);
+
+        enum SlotState { SLOT_FREE, SLOT_READ, SLOT_INFLATING, SLOT_DONE };
+
+        struct Slot {
+            std::vector<char> compressed;
+            std::vector<char> uncompressed;
+            int compressed_size; // as returned by read_block
+            int length;          // decompressed size or -1
+            SlotState state;
+        };
+
+        static void *reader_main(void *arg);
+        static void *worker_main(void *arg);
+        void read_ahead();
+        void inflate_blocks();
+
+        std::FILE *fp;
+        int nthreads;
+        std::vector<Slot> slots;
+        std::vector<pthread_t> threads;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t slot_free;
+        pthread_cond_t slot_read;
+        pthread_cond_t slot_done;
+
+        // sequence numbers of the next block to read, inflate and deliver
+        unsigned long read_seq;
+        unsigned long inflate_seq;
+        unsigned long deliver_seq;
+        bool holding;
+        bool stopping;
+    };
+
+    MFBgzfPool::MFBgzfPool(std::FILE *f, const int n) : fp(f), nthreads(n),
+    slots(4 * n), threads(), read_seq(0), inflate_seq(0), deliver_seq(0),
+    holding(false), stopping(false)
+    {
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            slots[i].compressed.resize(BGZF_MAX_BLOCK_SIZE);
+            slots[i].uncompressed.resize(BGZF_MAX_BLOCK_SIZE);
+            slots[i].compressed_size = 0;
+            slots[i].length = 0;
+            slots[i].state = SLOT_FREE;
+        }
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&slot_free, NULL);
+        pthread_cond_init(&slot_read, NULL);
+        pthread_cond_init(&slot_done, NULL);
+    }
+
+    MFBgzfPool::~MFBgzfPool()
+    {
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_broadcast(&slot_free);
+        pthread_cond_broadcast(&slot_read);
+        pthread_mutex_unlock(&mutex);
+
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            pthread_join(threads[i], NULL);
+        }
+
+        pthread_cond_destroy(&slot_done);
+        pthread_cond_destroy(&slot_read);
+        pthread_cond_destroy(&slot_free);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    int MFBgzfPool::start()
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, reader_main, this) != 0) return -1;
+        threads.push_back(thread);
+
+        for (int i = 0; i < nthreads; ++i) {
+            if (pthread_create(&thread, NULL, worker_main, this) != 0) return -1;
+            threads.push_back(thread);
+        }
+        return 0;
+    }
+
+    void *MFBgzfPool::reader_main(void *arg)
+    {
+        static_cast<MFBgzfPool *>(arg)->read_ahead();
+        return NULL;
+    }
+
+    void *MFBgzfPool::worker_main(void *arg)
+    {
+        static_cast<MFBgzfPool *>(arg)->inflate_blocks();
+        return NULL;
+    }
+
+    void MFBgzfPool::read_ahead()
+    {
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            Slot &slot = slots[read_seq % slots.size()];
+            while (!stopping && slot.state != SLOT_FREE) {
+                pthread_cond_wait(&slot_free, &mutex);
+            }
+            pthread_mutex_unlock(&mutex);
+            if (stopping) return;
+
+            // a free slot is only touched by this thread
+            int size = read_block(fp, slot.compressed);
+
+            pthread_mutex_lock(&mutex);
+            slot.compressed_size = size;
+            slot.state = SLOT_READ;
+            read_seq++;
+            pthread_cond_broadcast(&slot_read);
+            pthread_mutex_unlock(&mutex);
+
+            // end of file and read errors are passed on in the last slot
+            if (size <= 0) return;
+        }
+    }
+
+    void MFBgzfPool::inflate_blocks()
+    {
+        MFBgzfInflater inflater;
+
+        pthread_mutex_lock(&mutex);
+        while (true) {
+            while (!stopping && inflate_seq == read_seq) {
+                pthread_cond_wait(&slot_read, &mutex);
+            }
+            if (stopping) break;
+
+            Slot &slot = slots[inflate_seq % slots.size()];
+            inflate_seq++;
+            slot.state = SLOT_INFLATING;
+            pthread_mutex_unlock(&mutex);
+
+            int length = slot.compressed_size;
+            if (length > 0) {
+                length = inflater.decompress(&slot.compressed[0], slot.compressed_size, &slot.uncompressed[0]);
+            }
+
+            pthread_mutex_lock(&mutex);
+            slot.length = length;
+            slot.state = SLOT_DONE;
+            pthread_cond_broadcast(&slot_done);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+
+    int MFBgzfPool::next(const char *&data, std::size_t &length)
+    {
+        pthread_mutex_lock(&mutex);
+        if (holding) {
+            slots[deliver_seq % slots.size()].state = SLOT_FREE;
+            deliver_seq++;
+            holding = false;
+            pthread_cond_signal(&slot_free);
+        }
+
+        Slot &slot = slots[deliver_seq % slots.size()];
+        while (slot.state != SLOT_DONE) {
+            pthread_cond_wait(&slot_done, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (slot.length < 0) return -1;
+        // end of file stays in its slot for repeated calls
+        if (slot.compressed_size == 0) return 0;
+
+        holding = true;
+        data = &slot.uncompressed[0];
+        length = slot.length;
+        return 1;
+    }
+
+    MFBgzfReader::MFBgzfReader() : fp(NULL), own_fp(false),
+    compressed(BGZF_MAX_BLOCK_SIZE), uncompressed(BGZF_MAX_BLOCK_SIZE),
+    block_data(NULL), block_length(0), block_offset(0), inflater(), pool(NULL)
+    {
+    }
+
+    MFBgzfReader::~MFBgzfReader()
+    {
+        close();
+    }
+
+    int MFBgzfReader::open(const std::string &filename, const int nthreads)
+    {
+        close();
+        if (filename == "-") {
+            fp = stdin;
+            own_fp = false;
+        } else {
+            fp = fopen(filename.c_str(), "rb");
+            own_fp = true;
+        }
+        if (!fp) return -1;
+
+        if (nthreads > 1) {
+            pool = new MFBgzfPool(fp, nthreads);
+            if (pool->start() != 0) {
+                std::cerr << "[methylFlow] Error starting BGZF threads" << std::endl;
+                close();
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void MFBgzfReader::close()
+    {
+        // stop threads before the file goes away
+        delete pool;
+        pool = NULL;
+        if (fp && own_fp) fclose(fp);
+        fp = NULL;
+        own_fp = false;
+        block_data = NULL;
+        block_length = block_offset = 0;
+    }
+
+    int MFBgzfReader::next_block()
+    {
+        if (!fp) return -1;
+
+        int res;
+        if (pool) {
+            res = pool->next(block_data, block_length);
+        } else {
+            res = read_block(fp, compressed);
+            if (res > 0) {
+                int length = inflater.decompress(&compressed[0], res, &uncompressed[0]);
+                if (length < 0) {
+                    res = -1;
+                } else {
+                    block_data = &uncompressed[0];
+                    block_length = length;
+                    res = 1;
+                }
+            }
+        }
+
+        if (res < 0) {
+            std::cerr << "[methylFlow] Error reading BGZF block" << std::endl;
+        }
+        if (res <= 0) block_length = 0;
+        block_offset = 0;
+        return res;
+    }
+
+    long MFBgzfReader::read(void *buf, const std::size_t len)
+    {
+        char *out = static_cast<char *>(buf);
+        std::size_t copied = 0;
+        while (copied < len) {
+            if (block_offset == block_length) {
+                int res = next_block();
+                if (res < 0) return -1;
+                if (res == 0) break;
+                // empty blocks (e.g. the EOF marker) are skipped
+                continue;
+            }
+            std::size_t n = std::min(len - copied, block_length - block_offset);
+            memcpy(out + copied, block_data + block_offset, n);
+            block_offset += n;
+            copied += n;
+        }
+        return copied;
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,89 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+struct z_stream_s;
+
+#ifndef MFBGZF_H
+#define MFBGZF_H
+
+namespace methylFlow {
+
+    // largest BGZF block, compressed or decompressed
+    const std::size_t BGZF_MAX_BLOCK_SIZE = 65536;
+
+    // little-endian field access for BGZF/BAM data
+    inline unsigned int le_uint16(const char *p)
+    {
+        const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+        return u[0] | (u[1] << 8);
+    }
+
+    inline unsigned int le_uint32(const char *p)
+    {
+        const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+        return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int) u[3] << 24);
+    }
+
+    inline int le_int32(const char *p)
+    {
+        return (int) le_uint32(p);
+    }
+
+    // inflates single BGZF blocks, reusing its zlib state between blocks
+    class MFBgzfInflater {
+    public:
+        MFBgzfInflater();
+        ~MFBgzfInflater();
+
+        // decompress the complete block [block, block + block_size)
+        // into out, which must hold BGZF_MAX_BLOCK_SIZE bytes
+        // returns the number of bytes written or -1 on error
+        int decompress(const char *block, const std::size_t block_size, char *out);
+
+    private:
+        MFBgzfInflater(const MFBgzfInflater &);
+        z_stream_s *zs;
+    };
+
+    class MFBgzfPool;
+
+    // sequential reader of a BGZF compressed file (e.g. BAM)
+    class MFBgzfReader {
+    public:
+        MFBgzfReader();
+        ~MFBgzfReader();
+
+        // open file, "-" reads from stdin. returns 0 on success
+        // with nthreads > 1 blocks are read ahead on a separate thread
+        // and inflated on a pool of nthreads workers, otherwise they
+        // are inflated by the caller of read()
+        int open(const std::string &filename, const int nthreads = 1);
+        void close();
+
+        // read len decompressed bytes into buf, returns the number of
+        // bytes read (less than len only at end of file) or -1 on error
+        long read(void *buf, const std::size_t len);
+
+    private:
+        MFBgzfReader(const MFBgzfReader &);
+
+        // make the next block current, returns 1 on success,
+        // 0 at end of file and -1 on error
+        int next_block();
+
+        std::FILE *fp;
+        bool own_fp;
+        std::vector<char> compressed;
+        std::vector<char> uncompressed;
+        const char *block_data;
+        std::size_t block_length;
+        std::size_t block_offset;
+        MFBgzfInflater inflater;
+        MFBgzfPool *pool;
+    };
+
+} // namespace methylFlow
+
+#endif // MFBGZF_H
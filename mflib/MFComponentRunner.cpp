@@ -0,0 +1,358 @@
+#include <iostream>
+#include <sstream>
+
+#include <glpk.h>
+
+#include "MFComponentRunner.hpp"
+#include "MFGraph.hpp"
+
+namespace methylFlow {
+
+    // a built component graph and the output of solving it
+    struct MFComponentTask {
+        MFGraph *graph;
+        int componentID;
+        int chr;
+
+        std::ostringstream comp;
+        std::ostringstream patt;
+        std::ostringstream region;
+        bool done;
+    };
+
+    MFComponentRunner::MFComponentRunner(const int n) : nthreads(n < 1 ? 1 : n), threads(),
+    queued(), unwritten(), nactive(0), stopping(false), graphs(), free_graphs(),
+    contigs(NULL), flag_SAM(false), lambda(0), scale_mult(0), epsilon(0), verbose(false),
+    solver_options(), ncomponents(0), nclosed_form(0), comp_stream(NULL), patt_stream(NULL), region_stream(NULL),
+    stats_hook(NULL), stats_arg(NULL), last_stats(arena_stats())
+    {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&task_ready, NULL);
+        pthread_cond_init(&task_done, NULL);
+    }
+
+    MFComponentRunner::~MFComponentRunner()
+    {
+        for (std::size_t i = 0; i < graphs.size(); ++i) {
+            delete graphs[i];
+        }
+        pthread_cond_destroy(&task_done);
+        pthread_cond_destroy(&task_ready);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void *MFComponentRunner::worker_main(void *arg)
+    {
+        static_cast<MFComponentRunner *>(arg)->work();
+        // GLPK keeps its environment per thread
+        glp_free_env();
+        return NULL;
+    }
+
+    void MFComponentRunner::work()
+    {
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            while (!stopping && queued.empty()) {
+                pthread_cond_wait(&task_ready, &mutex);
+            }
+            if (queued.empty()) {
+                pthread_mutex_unlock(&mutex);
+                return;
+            }
+            MFComponentTask *task = queued.front();
+            queued.pop_front();
+            pthread_mutex_unlock(&mutex);
+
+            task->graph->run_component( task->componentID,
+                                        task->comp,
+                                        task->patt,
+                                        task->region,
+                                        task->chr,
+                                        flag_SAM,
+                                        lambda,
+                                        scale_mult,
+                                        epsilon,
+                                        verbose );
+            task->graph->clear_graph();
+
+            pthread_mutex_lock(&mutex);
+            task->done = true;
+            nactive--;
+            pthread_cond_broadcast(&task_done);
+            pthread_mutex_unlock(&mutex);
+        }
+    }
+
+    void MFComponentRunner::set_stats_hook(MFComponentStatsHook hook, void *arg)
+    {
+        stats_hook = hook;
+        stats_arg = arg;
+    }
+
+    void MFComponentRunner::set_solver_options(const MFSolverOptions &options)
+    {
+        solver_options = options;
+    }
+
+    void MFComponentRunner::report_finished(const int componentID)
+    {
+        if (verbose) {
+            std::cout << "[methylFlow] Finished processing component " << componentID << std::endl;
+        }
+        if (!stats_hook) return;
+        const MFArenaStats stats = arena_stats();
+        MFArenaStats delta;
+        delta.allocations = stats.allocations - last_stats.allocations;
+        delta.bytes = stats.bytes - last_stats.bytes;
+        delta.chunks_allocated = stats.chunks_allocated - last_stats.chunks_allocated;
+        delta.chunks_released = stats.chunks_released - last_stats.chunks_released;
+        last_stats = stats;
+        stats_hook(componentID, delta, stats_arg);
+    }
+
+    MFGraph *MFComponentRunner::take_graph()
+    {
+        MFGraph *graph;
+        pthread_mutex_lock(&mutex);
+        if (free_graphs.empty()) {
+            graph = new MFGraph();
+            graphs.push_back(graph);
+        } else {
+            graph = free_graphs.back();
+            free_graphs.pop_back();
+        }
+        pthread_mutex_unlock(&mutex);
+        graph->contigs = contigs;
+        graph->options = solver_options;
+        // a serial run builds every component after the first into a
+        // graph that was normalized before, so addNode sets the
+        // normalized coverage of nodes normalize_coverage does not reach
+        graph->is_normalized = ncomponents > 0;
+        return graph;
+    }
+
+    int MFComponentRunner::solve_component(MFGraph *graph, const int componentID, const int chr)
+    {
+        if (threads.empty()) {
+            graph->run_component( componentID,
+                                  *comp_stream,
+                                  *patt_stream,
+                                  *region_stream,
+                                  chr,
+                                  flag_SAM,
+                                  lambda,
+                                  scale_mult,
+                                  epsilon,
+                                  verbose );
+            graph->clear_graph();
+            pthread_mutex_lock(&mutex);
+            free_graphs.push_back(graph);
+            pthread_mutex_unlock(&mutex);
+            report_finished(componentID);
+            return 0;
+        }
+
+        MFComponentTask *task = new MFComponentTask();
+        task->graph = graph;
+        task->componentID = componentID;
+        task->chr = chr;
+        task->done = false;
+
+        pthread_mutex_lock(&mutex);
+        while (nactive >= 2 * nthreads) {
+            pthread_cond_wait(&task_done, &mutex);
+        }
+        nactive++;
+        queued.push_back(task);
+        unwritten.push_back(task);
+        pthread_cond_signal(&task_ready);
+        pthread_mutex_unlock(&mutex);
+
+        write_finished(false);
+        return 0;
+    }
+
+    void MFComponentRunner::write_finished(const bool wait_all)
+    {
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            if (wait_all) {
+                while (!unwritten.empty() && !unwritten.front()->done) {
+                    pthread_cond_wait(&task_done, &mutex);
+                }
+            }
+            MFComponentTask *task = NULL;
+            if (!unwritten.empty() && unwritten.front()->done) {
+                task = unwritten.front();
+                unwritten.pop_front();
+                free_graphs.push_back(task->graph);
+            }
+            pthread_mutex_unlock(&mutex);
+            if (!task) return;
+
+            *comp_stream << task->comp.str();
+            *patt_stream << task->patt.str();
+            *region_stream << task->region.str();
+            report_finished(task->componentID);
+            delete task;
+        }
+    }
+
+    // assumes reads are sorted by position
+    int MFComponentRunner::run( MFReadSource & source,
+                                std::ostream & comp,
+                                std::ostream & patt,
+                                std::ostream & region,
+                                int chr,
+                                const bool sam,
+                                const float l,
+                                const float scale,
+                                const float eps,
+                                const bool verb )
+    {
+        flag_SAM = sam;
+        lambda = l;
+        scale_mult = scale;
+        epsilon = eps;
+        verbose = verb;
+        comp_stream = &comp;
+        patt_stream = &patt;
+        region_stream = &region;
+        stopping = false;
+        ncomponents = 0;
+        nclosed_form = 0;
+        for (std::size_t i = 0; i < graphs.size(); ++i) {
+            graphs[i]->nclosed_form = 0;
+        }
+        contigs = source.contigs();
+        last_stats = arena_stats();
+
+        if (nthreads > 1) {
+            for (int i = 0; i < nthreads; ++i) {
+                pthread_t thread;
+                if (pthread_create(&thread, NULL, worker_main, this) != 0) break;
+                threads.push_back(thread);
+            }
+        }
+
+        std::string readid;
+        MFActiveSet activeSet;
+        ListDigraph::Node node;
+        int rightMostPos = 0;
+
+        const long READ_LIMIT = 100000000000L;
+#ifndef NDEBUG
+        bool check_count = true;
+#else
+        bool check_count = false;
+#endif
+
+        long count = 0;
+        int componentCount = 0;
+        int status = 0;
+
+        if (verbose) {
+            std::cout << "[methylFlow] Reading from file " << std::endl;
+        }
+
+        // print headers to output files
+        MFGraph::print_headers(comp, patt, region);
+        int lastChr = 0;
+        MFGraph *graph = take_graph();
+
+        while (!check_count || count < READ_LIMIT) {
+            MethylRead * m;
+            int res = source.next(m, readid, chr);
+            count++;
+            if (res == 0) break; // checks end of file
+            if (res < 0) {
+                status = -1;
+                break;
+            }
+
+#ifndef NDEBUG
+            std::cout << "read: " << readid << " " << m->getString() << std::endl;
+#endif
+
+            // does this read start after the rightMost end position?
+            if (m->start() > rightMostPos || chr != lastChr) {
+                if (verbose) {
+                    std::cout << "chr " << chr << std::endl;
+                    std::cout << "[methylFlow] last chr = " << lastChr << ", chr = " << chr << std::endl;
+                }
+
+                // the finished component is on the previous chromosome
+                int componentChr = lastChr;
+                lastChr = chr;
+                // clear active reads if necessary
+                if (!activeSet.empty()){
+                    activeSet.clear();
+                }
+
+                // process this connected component
+                if (count > 1) {
+                    componentCount++;
+                    ncomponents = componentCount;
+                    if (verbose) {
+                        std::cout << "[methylFlow] Processing component " << componentCount << std::endl;
+                        std::cout << "[methylFlow] Read number " << count << std::endl;
+                        std::cout << "[methylFlow] start read " << m->start() << std::endl;
+                        std::cout << "[methylFlow] rightMostPos " << rightMostPos << std::endl;
+                        std::cout << "[methylFlow] Collapsed " << graph->collapsed_reads() << " duplicate reads, skipping " << graph->skipped_entries() << " active set entries" << std::endl;
+                    }
+
+                    solve_component(graph, componentCount, componentChr);
+                    graph = take_graph();
+                }
+            }
+
+            // if no reads in active set, add the node to the graph
+            if (activeSet.empty()) {
+                node = graph->addNode(readid, 1, m);
+                graph->add_duplicate_entry(node, m, m->fingerprint());
+                activeSet.push_back(node, m);
+
+                // update the right-most position
+                rightMostPos = m->end();
+                continue;
+            }
+
+            // add read to graph
+            if (graph->processRead(m, readid, &activeSet) && m->end() > rightMostPos) {
+                rightMostPos = m->end();
+            }
+        }
+
+        if (status == 0) {
+            componentCount++;
+            if (verbose)
+            {
+                std::cout << "[methylFlow] Processing last component " << componentCount << std::endl;
+                std::cout << "[methylFlow] Read number " << count << std::endl;
+                std::cout << "[methylFlow] Collapsed " << graph->collapsed_reads() << " duplicate reads, skipping " << graph->skipped_entries() << " active set entries" << std::endl;
+            }
+            solve_component(graph, componentCount, lastChr);
+        } else {
+            graph->clear_graph();
+        }
+
+        write_finished(true);
+
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_broadcast(&task_ready);
+        pthread_mutex_unlock(&mutex);
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        threads.clear();
+
+        ncomponents = componentCount;
+        for (std::size_t i = 0; i < graphs.size(); ++i) {
+            nclosed_form += graphs[i]->nclosed_form;
+        }
+        return status;
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,127 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+
+#include <pthread.h>
+
+#include "MFReadSource.hpp"
+#include "MFReadArena.hpp"
+#include "MFSolverOptions.hpp"
+
+#ifndef MFCOMPONENTRUNNER_H
+#define MFCOMPONENTRUNNER_H
+
+namespace methylFlow {
+
+    class MFGraph;
+    struct MFComponentTask;
+
+    // called as each component is written, with the read arena
+    // allocations since the previous one (see MFReadArena)
+    typedef void (*MFComponentStatsHook)(const int componentID, const MFArenaStats &stats, void *arg);
+
+    // splits a sorted read source into connected components and solves
+    // them. the overlap graph of a component is built on the calling
+    // thread, since component boundaries depend on the reads accepted
+    // into it. with nthreads > 1 finished graphs are handed to a pool of
+    // workers, each solving one component at a time, and their output is
+    // written in component order so it matches a serial run
+    // at most 2 * nthreads components are queued or running at a time
+    class MFComponentRunner {
+    public:
+        MFComponentRunner(const int nthreads);
+        ~MFComponentRunner();
+
+        // same arguments as MFGraph::run
+        int run( MFReadSource & source,
+                 std::ostream & comp_stream,
+                 std::ostream & patt_stream,
+                 std::ostream & region_stream,
+                 int chr,
+                 const bool flag_SAM,
+                 const float lambda,
+                 const float scale_mult,
+                 const float epsilon,
+                 const bool verbose );
+
+        // number of components processed by the last run
+        const int &component_count() const;
+
+        // of which solved in closed form (MFGraph::closed_form_count)
+        const int &closed_form_count() const;
+
+        void set_stats_hook(MFComponentStatsHook hook, void *arg);
+
+        // passed on to the graphs solving components
+        void set_solver_options(const MFSolverOptions &options);
+
+    private:
+        MFComponentRunner(const MFComponentRunner &);
+
+        static void *worker_main(void *arg);
+        void work();
+
+        // an empty graph, reused from finished components if possible
+        MFGraph *take_graph();
+
+        // solve the component built in graph. solved on this thread with
+        // a single thread, otherwise queued for the workers
+        int solve_component(MFGraph *graph, const int componentID, const int chr);
+
+        // write finished components at the front of the output order,
+        // waits for all of them if wait_all
+        void write_finished(const bool wait_all);
+
+        // reports a component once its output is written, on the
+        // thread writing it
+        void report_finished(const int componentID);
+
+        int nthreads;
+        std::vector<pthread_t> threads;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t task_ready;
+        pthread_cond_t task_done;
+
+        std::deque<MFComponentTask *> queued;
+        std::deque<MFComponentTask *> unwritten; // in component order
+        int nactive; // queued or running
+        bool stopping;
+
+        std::vector<MFGraph *> graphs; // all graphs, owned
+        std::vector<MFGraph *> free_graphs;
+
+        // settings of the current run
+        const MFContigs *contigs;
+        bool flag_SAM;
+        float lambda;
+        float scale_mult;
+        float epsilon;
+        bool verbose;
+        MFSolverOptions solver_options;
+        int ncomponents;
+        int nclosed_form;
+
+        std::ostream *comp_stream;
+        std::ostream *patt_stream;
+        std::ostream *region_stream;
+
+        MFComponentStatsHook stats_hook;
+        void *stats_arg;
+        MFArenaStats last_stats;
+    };
+
+    inline const int &MFComponentRunner::component_count() const
+    {
+        return ncomponents;
+    }
+
+    inline const int &MFComponentRunner::closed_form_count() const
+    {
+        return nclosed_form;
+    }
+
+} // namespace methylFlow
+
+#endif // MFCOMPONENTRUNNER_H
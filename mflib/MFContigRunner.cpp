@@ -0,0 +1,290 @@
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+
+#include <glpk.h>
+
+#include "MFContigRunner.hpp"
+#include "MFGraph.hpp"
+
+namespace methylFlow {
+
+    // reads of one contig and the output of running them
+    struct MFContigTask {
+        int chr;
+        std::vector<MethylRead *> reads;
+        std::vector<std::string> readids;
+
+        std::ostringstream comp;
+        std::ostringstream patt;
+        std::ostringstream region;
+        int ncomponents;
+        int nclosed_form;
+        int status;
+        bool done;
+    };
+
+    // hands the reads of a task to MFGraph::run
+    class MFContigTaskSource : public MFReadSource {
+    public:
+        MFContigTaskSource(MFContigTask &t, const MFContigs *c) : task(t), contig_dict(c), pos(0)
+        {
+        }
+
+        // reads not taken by the graph are deleted
+        ~MFContigTaskSource()
+        {
+            for (; pos < task.reads.size(); ++pos) delete task.reads[pos];
+            task.reads.clear();
+        }
+
+        int next(MethylRead *&read, std::string &readid, int &chr)
+        {
+            if (pos == task.reads.size()) return 0;
+            read = task.reads[pos];
+            readid.swap(task.readids[pos]);
+            chr = task.chr;
+            pos++;
+            return 1;
+        }
+
+        const MFContigs *contigs() const
+        {
+            return contig_dict;
+        }
+
+    private:
+        MFContigTask &task;
+        const MFContigs *contig_dict;
+        std::size_t pos;
+    };
+
+    // copy output of a task without its header line, adding offset to
+    // the component id in the fourth column
+    static void append_output(std::ostream &out, const std::string &text, const int offset)
+    {
+        std::size_t line = text.find('\n');
+        while (line != std::string::npos && line + 1 < text.size()) {
+            std::size_t start = line + 1;
+            line = text.find('\n', start);
+            std::size_t end = line == std::string::npos ? text.size() : line + 1;
+
+            std::size_t cid = start;
+            for (int tabs = 0; tabs < 3 && cid != std::string::npos; ++tabs) {
+                cid = text.find('\t', cid);
+                if (cid != std::string::npos) cid++;
+            }
+            if (cid == std::string::npos || cid >= end) {
+                out.write(text.data() + start, end - start);
+                continue;
+            }
+
+            char *cid_end;
+            long id = strtol(text.c_str() + cid, &cid_end, 10);
+            out.write(text.data() + start, cid - start);
+            out << id + offset;
+            out.write(cid_end, text.data() + end - cid_end);
+        }
+    }
+
+    MFContigRunner::MFContigRunner(const int n) : nthreads(n < 1 ? 1 : n), threads(),
+    queued(), unwritten(), nactive(0), stopping(false), contigs(NULL), flag_SAM(false),
+    lambda(0), scale_mult(0), epsilon(0), verbose(false), solver_options(),
+    comp_stream(NULL), patt_stream(NULL), region_stream(NULL), component_offset(0),
+    nclosed_form(0)
+    {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&task_ready, NULL);
+        pthread_cond_init(&task_done, NULL);
+    }
+
+    MFContigRunner::~MFContigRunner()
+    {
+        pthread_cond_destroy(&task_done);
+        pthread_cond_destroy(&task_ready);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void *MFContigRunner::worker_main(void *arg)
+    {
+        static_cast<MFContigRunner *>(arg)->work();
+        // GLPK keeps its environment per thread
+        glp_free_env();
+        return NULL;
+    }
+
+    void MFContigRunner::work()
+    {
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            while (!stopping && queued.empty()) {
+                pthread_cond_wait(&task_ready, &mutex);
+            }
+            if (queued.empty()) {
+                pthread_mutex_unlock(&mutex);
+                return;
+            }
+            MFContigTask *task = queued.front();
+            queued.pop_front();
+            pthread_mutex_unlock(&mutex);
+
+            MFGraph g;
+            g.set_solver_options(solver_options);
+            {
+                MFContigTaskSource source(*task, contigs);
+                task->status = g.run( source,
+                                      task->comp,
+                                      task->patt,
+                                      task->region,
+                                      task->chr,
+                                      flag_SAM,
+                                      lambda,
+                                      scale_mult,
+                                      epsilon,
+                                      verbose );
+            }
+            task->ncomponents = g.component_count();
+            task->nclosed_form = g.closed_form_count();
+
+            pthread_mutex_lock(&mutex);
+            task->done = true;
+            nactive--;
+            pthread_cond_broadcast(&task_done);
+            pthread_mutex_unlock(&mutex);
+        }
+    }
+
+    void MFContigRunner::reserve()
+    {
+        pthread_mutex_lock(&mutex);
+        while (nactive >= nthreads) {
+            pthread_cond_wait(&task_done, &mutex);
+        }
+        nactive++;
+        pthread_mutex_unlock(&mutex);
+    }
+
+    void MFContigRunner::submit(MFContigTask *task)
+    {
+        pthread_mutex_lock(&mutex);
+        queued.push_back(task);
+        unwritten.push_back(task);
+        pthread_cond_signal(&task_ready);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    int MFContigRunner::write_finished(const bool wait_all)
+    {
+        int status = 0;
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            if (wait_all) {
+                while (!unwritten.empty() && !unwritten.front()->done) {
+                    pthread_cond_wait(&task_done, &mutex);
+                }
+            }
+            MFContigTask *task = NULL;
+            if (!unwritten.empty() && unwritten.front()->done) {
+                task = unwritten.front();
+                unwritten.pop_front();
+            }
+            pthread_mutex_unlock(&mutex);
+            if (!task) return status;
+
+            if (task->status != 0) status = -1;
+            append_output(*comp_stream, task->comp.str(), component_offset);
+            append_output(*patt_stream, task->patt.str(), component_offset);
+            append_output(*region_stream, task->region.str(), component_offset);
+            component_offset += task->ncomponents;
+            nclosed_form += task->nclosed_form;
+            delete task;
+        }
+    }
+
+    void MFContigRunner::set_solver_options(const MFSolverOptions &options)
+    {
+        solver_options = options;
+    }
+
+    int MFContigRunner::run( MFReadSource & source,
+                             std::ostream & comp,
+                             std::ostream & patt,
+                             std::ostream & region,
+                             int chr,
+                             const bool sam,
+                             const float l,
+                             const float scale,
+                             const float eps,
+                             const bool verb )
+    {
+        flag_SAM = sam;
+        lambda = l;
+        scale_mult = scale;
+        epsilon = eps;
+        verbose = verb;
+        comp_stream = &comp;
+        patt_stream = &patt;
+        region_stream = &region;
+        component_offset = 0;
+        nclosed_form = 0;
+        stopping = false;
+
+        MFGraph::print_headers(comp, patt, region);
+
+        // contigs are complete once the first read was returned
+        std::string readid;
+        MethylRead *m;
+        int res = source.next(m, readid, chr);
+        contigs = source.contigs();
+
+        for (int i = 0; i < nthreads; ++i) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, worker_main, this) != 0) {
+                if (res > 0) delete m;
+                res = -1;
+                break;
+            }
+            threads.push_back(thread);
+        }
+
+        MFContigTask *task = NULL;
+        int status = 0;
+        while (res > 0) {
+            if (!task || chr != task->chr) {
+                if (task) {
+                    if (verbose) {
+                        std::cout << "[methylFlow] Contig " << task->chr << " read, " << task->reads.size() << " reads" << std::endl;
+                    }
+                    submit(task);
+                    if (write_finished(false) != 0) status = -1;
+                }
+                // the contig being read counts against nthreads too
+                reserve();
+                task = new MFContigTask();
+                task->chr = chr;
+                task->ncomponents = 0;
+                task->nclosed_form = 0;
+                task->status = 0;
+                task->done = false;
+            }
+            task->reads.push_back(m);
+            task->readids.push_back(readid);
+            res = source.next(m, readid, chr);
+        }
+        if (task) submit(task);
+        if (res < 0) status = -1;
+
+        if (write_finished(true) != 0) status = -1;
+
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_broadcast(&task_ready);
+        pthread_mutex_unlock(&mutex);
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        threads.clear();
+        return status;
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,107 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+
+#include <pthread.h>
+
+#include "MFReadSource.hpp"
+#include "MFSolverOptions.hpp"
+
+#ifndef MFCONTIGRUNNER_H
+#define MFCONTIGRUNNER_H
+
+namespace methylFlow {
+
+    struct MFContigTask;
+
+    // runs the contigs of a read source in parallel, each one on a worker
+    // thread with its own MFGraph. reads of a contig are buffered until the
+    // next contig starts and then handed to a worker, at most nthreads
+    // contigs are being read, buffered or running at a time
+    // output is merged in input order (header order for sorted SAM/BAM)
+    // with component ids renumbered, so it matches MFGraph::run
+    class MFContigRunner {
+    public:
+        MFContigRunner(const int nthreads);
+        ~MFContigRunner();
+
+        // same arguments as MFGraph::run
+        int run( MFReadSource & source,
+                 std::ostream & comp_stream,
+                 std::ostream & patt_stream,
+                 std::ostream & region_stream,
+                 int chr,
+                 const bool flag_SAM,
+                 const float lambda,
+                 const float scale_mult,
+                 const float epsilon,
+                 const bool verbose );
+
+        // passed on to the graphs solving components
+        void set_solver_options(const MFSolverOptions &options);
+
+        // components of the last run, and of them solved in closed form
+        // (MFGraph::closed_form_count)
+        const int &component_count() const;
+        const int &closed_form_count() const;
+
+    private:
+        MFContigRunner(const MFContigRunner &);
+
+        static void *worker_main(void *arg);
+        void work();
+
+        // take a slot for the next contig before its reads are buffered,
+        // waits while nthreads contigs are being read, queued or running
+        void reserve();
+
+        // queue task for the workers, its slot was taken by reserve
+        void submit(MFContigTask *task);
+
+        // write finished tasks at the front of the output order,
+        // waits for all of them if wait_all. returns -1 if one failed
+        int write_finished(const bool wait_all);
+
+        int nthreads;
+        std::vector<pthread_t> threads;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t task_ready;
+        pthread_cond_t task_done;
+
+        std::deque<MFContigTask *> queued;
+        std::deque<MFContigTask *> unwritten; // in input order
+        int nactive; // being read, queued or running
+        bool stopping;
+
+        // settings of the current run
+        const MFContigs *contigs;
+        bool flag_SAM;
+        float lambda;
+        float scale_mult;
+        float epsilon;
+        bool verbose;
+        MFSolverOptions solver_options;
+
+        // output streams and component id offset while writing
+        std::ostream *comp_stream;
+        std::ostream *patt_stream;
+        std::ostream *region_stream;
+        int component_offset;
+        int nclosed_form;
+    };
+
+    inline const int &MFContigRunner::component_count() const
+    {
+        return component_offset;
+    }
+
+    inline const int &MFContigRunner::closed_form_count() const
+    {
+        return nclosed_form;
+    }
+
+} // namespace methylFlow
+
+#endif // MFCONTIGRUNNER_H
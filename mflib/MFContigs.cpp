@@ -0,0 +1,75 @@
+#include <cstdlib>
+
+#include "MFContigs.hpp"
+
+namespace methylFlow {
+
+    int contig_number(const std::string &name)
+    {
+        if (name.compare(0, 3, "chr") == 0) return atoi(name.c_str() + 3);
+        return atoi(name.c_str());
+    }
+
+    MFContigs::MFContigs() : names(), labels(), lengths(), ids()
+    {
+    }
+
+    void MFContigs::clear()
+    {
+        names.clear();
+        labels.clear();
+        lengths.clear();
+        ids.clear();
+    }
+
+    int MFContigs::add(const std::string &name, const long length)
+    {
+        std::map<std::string, int>::const_iterator it = ids.find(name);
+        if (it != ids.end()) return it->second;
+
+        int id = names.size();
+        names.push_back(name);
+        labels.push_back(name.compare(0, 3, "chr") == 0 && name.size() > 3 ? name.substr(3) : name);
+        lengths.push_back(length);
+        ids[name] = id;
+        return id;
+    }
+
+    int MFContigs::add_header_line(const std::string &line)
+    {
+        std::string name;
+        long length = 0;
+        bool has_name = false;
+
+        // tab-separated TAG:VALUE fields after @SQ
+        std::size_t start = line.find('\t');
+        while (start != std::string::npos) {
+            std::size_t end = line.find('\t', start + 1);
+            std::string field = line.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+            if (field.compare(0, 3, "SN:") == 0) {
+                name = field.substr(3);
+                has_name = !name.empty();
+            } else if (field.compare(0, 3, "LN:") == 0) {
+                length = atol(field.c_str() + 3);
+            }
+            start = end;
+        }
+        if (!has_name) return -1;
+        return add(name, length);
+    }
+
+    int MFContigs::find(const std::string &name) const
+    {
+        std::map<std::string, int>::const_iterator it = ids.find(name);
+        return it == ids.end() ? -1 : it->second;
+    }
+
+    int MFContigs::lookup(const std::string &name) const
+    {
+        int id = find(name);
+        if (id >= 0) return id;
+        if (name.compare(0, 3, "chr") == 0) return find(name.substr(3));
+        return find("chr" + name);
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+
+#ifndef MFCONTIGS_H
+#define MFCONTIGS_H
+
+namespace methylFlow {
+
+    // chromosome number from a contig name as used before contig
+    // dictionaries: digits after a "chr" prefix, 0 otherwise
+    int contig_number(const std::string &name);
+
+    // contig dictionary from a SAM/BAM header (@SQ lines)
+    // contig ids are positions in header order, they are the chr
+    // numbers handed out by read sources that have a dictionary
+    class MFContigs {
+    public:
+        MFContigs();
+
+        void clear();
+
+        // add contig, returns its id. names already present keep their id
+        int add(const std::string &name, const long length = 0);
+
+        // add contig of a SAM @SQ header line, returns its id or -1
+        // if the line has no SN field
+        int add_header_line(const std::string &line);
+
+        // id of a contig name, -1 if not present
+        int find(const std::string &name) const;
+
+        // as find, also matching names with the "chr" prefix
+        // added or removed (e.g. 11 or chr11) for user input
+        int lookup(const std::string &name) const;
+
+        std::size_t size() const;
+        bool empty() const;
+        const std::string &name(const int id) const;
+        long length(const int id) const;
+
+        // text for the chr column of output files: the name without
+        // its "chr" prefix, so chr11 prints as 11 as before and chrX as X
+        const std::string &label(const int id) const;
+
+    private:
+        std::vector<std::string> names;
+        std::vector<std::string> labels;
+        std::vector<long> lengths;
+        std::map<std::string, int> ids;
+    };
+
+    inline std::size_t MFContigs::size() const
+    {
+        return names.size();
+    }
+
+    inline bool MFContigs::empty() const
+    {
+        return names.empty();
+    }
+
+    inline const std::string &MFContigs::name(const int id) const
+    {
+        return names[id];
+    }
+
+    inline long MFContigs::length(const int id) const
+    {
+        return lengths[id];
+    }
+
+    inline const std::string &MFContigs::label(const int id) const
+    {
+        return labels[id];
+    }
+
+} // namespace methylFlow
+
+#endif // MFCONTIGS_H
@@ -0,0 +1,287 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MFCpgIndex.hpp"
+
+namespace methylFlow {
+
+    static inline void put_uint32(std::vector<unsigned char> &out, const uint32_t v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back((v >> 8) & 0xff);
+        out.push_back((v >> 16) & 0xff);
+        out.push_back((v >> 24) & 0xff);
+    }
+
+    static inline void put_uint64(std::vector<unsigned char> &out, const uint64_t v)
+    {
+        put_uint32(out, v & 0xffffffff);
+        put_uint32(out, v >> 32);
+    }
+
+    static inline uint32_t get_uint32(const unsigned char *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    static inline uint64_t get_uint64(const unsigned char *p)
+    {
+        return get_uint32(p) | ((uint64_t) get_uint32(p + 4) << 32);
+    }
+
+    static bool little_endian()
+    {
+        const uint32_t one = 1;
+        return *reinterpret_cast<const unsigned char *>(&one) == 1;
+    }
+
+    // positions are written as they are found, the header and table
+    // once the whole reference is scanned
+    int MFCpgIndex::build(const std::string &fasta_filename, const std::string &filename)
+    {
+        std::FILE *in = std::fopen(fasta_filename.c_str(), "rb");
+        if (!in) return -1;
+        std::FILE *out = std::fopen(filename.c_str(), "wb");
+        if (!out) {
+            std::fclose(in);
+            return -1;
+        }
+
+        std::vector<unsigned char> buf(MFC_HEADER_SIZE, 0);
+        std::fwrite(&buf[0], 1, buf.size(), out);
+
+        std::vector<std::string> contig_names;
+        std::vector<uint64_t> contig_first;
+        std::vector<uint64_t> contig_lengths;
+        uint64_t count = 0;
+        uint64_t pos = 0; // sequence characters seen on the contig
+        bool in_header = false, line_start = true, prev_c = false;
+        bool name_done = false, ok = true;
+        std::string name;
+
+        std::vector<char> chunk(1 << 20);
+        std::size_t n;
+        while (ok && (n = std::fread(&chunk[0], 1, chunk.size(), in)) > 0) {
+            buf.clear();
+            for (std::size_t i = 0; i < n; ++i) {
+                const char c = chunk[i];
+                if (in_header) {
+                    if (c == '\n') {
+                        in_header = false;
+                        line_start = true;
+                        contig_names.push_back(name);
+                    } else if (c == ' ' || c == '\t' || c == '\r') {
+                        name_done = true;
+                    } else if (!name_done) {
+                        name += c;
+                    }
+                    continue;
+                }
+                if (c == '\n') {
+                    line_start = true;
+                    continue;
+                }
+                if (line_start && c == '>') {
+                    if (!contig_first.empty()) contig_lengths.push_back(pos);
+                    contig_first.push_back(count);
+                    in_header = true;
+                    name_done = false;
+                    name.clear();
+                    pos = 0;
+                    prev_c = false;
+                    continue;
+                }
+                line_start = false;
+                if (c == '\r' || c == ' ' || c == '\t') continue;
+                if (contig_first.empty()) {
+                    // sequence before the first header
+                    ok = false;
+                    break;
+                }
+
+                pos++;
+                if (prev_c && (c == 'G' || c == 'g')) {
+                    if (pos - 1 > 0xffffffffULL) {
+                        ok = false;
+                        break;
+                    }
+                    put_uint32(buf, pos - 1);
+                    count++;
+                }
+                prev_c = c == 'C' || c == 'c';
+            }
+            if (!buf.empty() && std::fwrite(&buf[0], 1, buf.size(), out) != buf.size()) ok = false;
+        }
+        if (std::ferror(in)) ok = false;
+        std::fclose(in);
+
+        // a last header without a line end
+        if (in_header) contig_names.push_back(name);
+        if (!contig_first.empty()) contig_lengths.push_back(pos);
+        if (contig_first.empty()) ok = false;
+
+        // table, aligned for the 8 byte entries
+        const uint64_t table_offset = (MFC_HEADER_SIZE + 4 * count + 7) & ~(uint64_t) 7;
+        buf.assign(table_offset - (MFC_HEADER_SIZE + 4 * count), 0);
+        for (std::size_t i = 0; i < contig_first.size(); ++i) {
+            put_uint64(buf, contig_first[i]);
+            put_uint64(buf, contig_lengths[i]);
+        }
+        put_uint64(buf, count);
+        for (std::size_t i = 0; i < contig_names.size(); ++i) {
+            buf.insert(buf.end(), contig_names[i].begin(), contig_names[i].end());
+            buf.push_back(0);
+        }
+        if (ok && std::fwrite(&buf[0], 1, buf.size(), out) != buf.size()) ok = false;
+
+        buf.assign(MFC_MAGIC, MFC_MAGIC + sizeof(MFC_MAGIC));
+        put_uint32(buf, contig_first.size());
+        put_uint64(buf, table_offset);
+        if (ok && (std::fseek(out, 0, SEEK_SET) != 0 ||
+                   std::fwrite(&buf[0], 1, buf.size(), out) != buf.size())) ok = false;
+
+        if (std::fclose(out) != 0) ok = false;
+        return ok ? 0 : -1;
+    }
+
+    MFCpgIndex::MFCpgIndex() : fd(-1), data(NULL), size(0), positions(NULL), first(), names()
+    {
+    }
+
+    MFCpgIndex::~MFCpgIndex()
+    {
+        close();
+    }
+
+    int MFCpgIndex::open(const std::string &filename)
+    {
+        close();
+
+        // positions are searched in place
+        if (!little_endian()) return -1;
+
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return -1;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+            (std::size_t) st.st_size < MFC_HEADER_SIZE) {
+            close();
+            return -1;
+        }
+
+        size = st.st_size;
+        void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close();
+            return -1;
+        }
+        data = static_cast<unsigned char *>(addr);
+
+        if (memcmp(data, MFC_MAGIC, sizeof(MFC_MAGIC)) != 0) {
+            std::cerr << "[methylFlow] Not a CpG index file: " << filename << std::endl;
+            close();
+            return -1;
+        }
+
+        const uint32_t ncontigs = get_uint32(data + 4);
+        const uint64_t table_offset = get_uint64(data + 8);
+        const unsigned char *p = data + table_offset;
+        const unsigned char *last = data + size;
+        if (table_offset > size || (uint64_t) (last - p) < 16 * (uint64_t) ncontigs + 8) {
+            std::cerr << "[methylFlow] Truncated CpG index file: " << filename << std::endl;
+            close();
+            return -1;
+        }
+
+        std::vector<uint64_t> lengths;
+        for (uint32_t i = 0; i < ncontigs; ++i, p += 16) {
+            first.push_back(get_uint64(p));
+            lengths.push_back(get_uint64(p + 8));
+        }
+        first.push_back(get_uint64(p));
+        p += 8;
+
+        bool ok = MFC_HEADER_SIZE + 4 * first.back() <= table_offset;
+        for (uint32_t i = 0; ok && i < ncontigs; ++i) {
+            const unsigned char *end = static_cast<const unsigned char *>(memchr(p, 0, last - p));
+            ok = end != NULL && first[i] <= first[i + 1];
+            if (!ok) break;
+            names.add(std::string(reinterpret_cast<const char *>(p), end - p), lengths[i]);
+            p = end + 1;
+        }
+        if (!ok || names.size() != ncontigs) {
+            std::cerr << "[methylFlow] Error parsing CpG index file: " << filename << std::endl;
+            close();
+            return -1;
+        }
+
+        positions = reinterpret_cast<const uint32_t *>(data + MFC_HEADER_SIZE);
+        return 0;
+    }
+
+    void MFCpgIndex::close()
+    {
+        if (data) munmap(data, size);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        data = NULL;
+        size = 0;
+        positions = NULL;
+        first.clear();
+        names.clear();
+    }
+
+    uint64_t MFCpgIndex::ordinal(const int contig, const long pos) const
+    {
+        const uint32_t *begin = positions + first[contig];
+        const uint32_t *end = positions + first[contig + 1];
+        if (pos <= 0) return first[contig];
+        if ((uint64_t) pos > 0xffffffffULL) return first[contig + 1];
+        return std::lower_bound(begin, end, (uint32_t) pos) - positions;
+    }
+
+    void MFCpgIndex::ordinal_range(const int contig, const long start, const long end,
+                                   uint64_t &first_ordinal, uint64_t &last_ordinal) const
+    {
+        first_ordinal = ordinal(contig, start);
+        last_ordinal = end < start ? first_ordinal : ordinal(contig, end + 1);
+    }
+
+    bool MFCpgIndex::is_cpg(const int contig, const long pos) const
+    {
+        const uint64_t i = ordinal(contig, pos);
+        return i < first[contig + 1] && (long) positions[i] == pos;
+    }
+
+    int MFCpgIndex::contig_of(const uint64_t ordinal) const
+    {
+        // first contig whose CpGs end after ordinal, skipping contigs
+        // without CpGs
+        return std::upper_bound(first.begin() + 1, first.end(), ordinal) - (first.begin() + 1);
+    }
+
+    int MFCpgIndex::read_ordinals(const MethylRead &read, const int contig, std::vector<uint64_t> &out) const
+    {
+        out.clear();
+        int missing = 0;
+        for (std::size_t i = 0; i < read.cpgOffset.size(); ++i) {
+            const long pos = (long) read.start() + read.cpgOffset[i];
+            const uint64_t o = ordinal(contig, pos);
+            if (o < first[contig + 1] && (long) positions[o] == pos) {
+                out.push_back(o);
+            } else {
+                missing++;
+            }
+        }
+        return missing;
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,105 @@
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "MethylRead.hpp"
+#include "MFContigs.hpp"
+
+#ifndef MFCPGINDEX_H
+#define MFCPGINDEX_H
+
+namespace methylFlow {
+
+    // .mfc: sorted CpG sites of a reference, mapped in place
+    //
+    // file:  "MFC\1", ncontigs <uint32>, table offset <uint64>,
+    //        then positions up to the table (little-endian)
+    // positions: <uint32> 1-based position of the C of each CpG,
+    //        contigs in FASTA order, sorted within a contig
+    // table: per contig the ordinal of its first CpG <uint64> and its
+    //        sequence length <uint64>, then the total number of CpGs
+    //        <uint64>, then contig names, each ended by a NUL
+    //
+    // CpG ordinals are global: the CpGs of a contig follow those of the
+    // contigs before it, so ordinals of a region are an integer range
+    const char MFC_MAGIC[4] = { 'M', 'F', 'C', 1 };
+    const std::size_t MFC_HEADER_SIZE = 16;
+
+    class MFCpgIndex {
+    public:
+        MFCpgIndex();
+        ~MFCpgIndex();
+
+        // scan a FASTA reference once and write its index to filename
+        // sequence names are taken up to the first whitespace
+        // returns 0 on success
+        static int build(const std::string &fasta_filename, const std::string &filename);
+
+        // map an index, returns 0 on success
+        int open(const std::string &filename);
+        void close();
+
+        // contigs of the reference, lengths are sequence lengths. use
+        // contigs().lookup for names given with or without "chr"
+        const MFContigs &contigs() const;
+
+        uint64_t ncpgs() const;
+        uint64_t contig_ncpgs(const int contig) const;
+
+        // ordinal of the first CpG at or after pos (1-based) on contig,
+        // the first ordinal of the next contig if there is none
+        uint64_t ordinal(const int contig, const long pos) const;
+
+        // ordinals [first, last) of the CpGs in start..end (1-based,
+        // inclusive) on contig
+        void ordinal_range(const int contig, const long start, const long end,
+                           uint64_t &first, uint64_t &last) const;
+
+        // is there a CpG with its C at pos (1-based) on contig
+        bool is_cpg(const int contig, const long pos) const;
+
+        // contig and 1-based position of a CpG ordinal < ncpgs()
+        int contig_of(const uint64_t ordinal) const;
+        long position(const uint64_t ordinal) const;
+
+        // ordinals of the CpGs of read on contig, in the order of its
+        // offsets. returns the number of offsets that are not a CpG of
+        // the reference, those are left out
+        int read_ordinals(const MethylRead &read, const int contig, std::vector<uint64_t> &out) const;
+
+    private:
+        MFCpgIndex(const MFCpgIndex &);
+
+        int fd;
+        unsigned char *data;
+        std::size_t size;
+
+        const uint32_t *positions;
+        std::vector<uint64_t> first; // ncontigs + 1 entries
+        MFContigs names;
+    };
+
+    inline const MFContigs &MFCpgIndex::contigs() const
+    {
+        return names;
+    }
+
+    inline uint64_t MFCpgIndex::ncpgs() const
+    {
+        return first.empty() ? 0 : first.back();
+    }
+
+    inline uint64_t MFCpgIndex::contig_ncpgs(const int contig) const
+    {
+        return first[contig + 1] - first[contig];
+    }
+
+    inline long MFCpgIndex::position(const uint64_t ordinal) const
+    {
+        return positions[ordinal];
+    }
+
+} // namespace methylFlow
+
+#endif // MFCPGINDEX_H
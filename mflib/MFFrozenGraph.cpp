@@ -0,0 +1,193 @@
+#include <algorithm>
+
+#include "MFFrozenGraph.hpp"
+#include "MFGraph.hpp"
+
+using namespace lemon;
+
+namespace methylFlow {
+
+    MFFrozenGraph::MFFrozenGraph() : source_index(-1), sink_index(-1)
+    {
+    }
+
+    void MFFrozenGraph::clear()
+    {
+        node.clear();
+        fake.clear();
+        childless.clear();
+        normalized_coverage.clear();
+        arc.clear();
+        arc_source.clear();
+        arc_target.clear();
+        effective_length.clear();
+        flow.clear();
+        out_first.clear();
+        out_arcs.clear();
+        in_first.clear();
+        in_arcs.clear();
+        real.clear();
+        index_of.clear();
+        heap.clear();
+        heap_index.clear();
+        dist.clear();
+        pred.clear();
+        source_index = -1;
+        sink_index = -1;
+    }
+
+    void MFFrozenGraph::freeze(const MFGraph &graph)
+    {
+        const ListDigraph &g = graph.get_graph();
+        clear();
+
+        index_of.resize(g.maxNodeId() + 1, -1);
+        for (ListDigraph::NodeIt v(g); v != INVALID; ++v) {
+            index_of[g.id(v)] = (int) node.size();
+            node.push_back(v);
+            fake.push_back(graph.fake[v]);
+            childless.push_back(graph.childless[v]);
+            normalized_coverage.push_back(graph.normalized_coverage(v));
+        }
+        source_index = index_of[g.id(graph.get_source())];
+        sink_index = index_of[g.id(graph.get_sink())];
+
+        std::vector<int> arc_index(g.maxArcId() + 1, -1);
+        for (ListDigraph::ArcIt a(g); a != INVALID; ++a) {
+            arc_index[g.id(a)] = (int) arc.size();
+            arc.push_back(a);
+            arc_source.push_back(index_of[g.id(g.source(a))]);
+            arc_target.push_back(index_of[g.id(g.target(a))]);
+            effective_length.push_back(graph.effective_length(a));
+        }
+        flow.resize(arc.size(), 0.);
+
+        const int n = node_count();
+        out_first.reserve(n + 1);
+        in_first.reserve(n + 1);
+        out_arcs.reserve(arc.size());
+        in_arcs.reserve(arc.size());
+        for (int i = 0; i < n; ++i) {
+            out_first.push_back((int) out_arcs.size());
+            for (ListDigraph::OutArcIt a(g, node[i]); a != INVALID; ++a) {
+                out_arcs.push_back(arc_index[g.id(a)]);
+            }
+            in_first.push_back((int) in_arcs.size());
+            for (ListDigraph::InArcIt a(g, node[i]); a != INVALID; ++a) {
+                in_arcs.push_back(arc_index[g.id(a)]);
+            }
+        }
+        out_first.push_back((int) out_arcs.size());
+        in_first.push_back((int) in_arcs.size());
+
+        for (IterableBoolMap<ListDigraph, ListDigraph::Node>::FalseIt v(graph.fake); v != INVALID; ++v) {
+            real.push_back(index_of[g.id(v)]);
+        }
+
+        heap_index.resize(n);
+        dist.resize(n);
+        pred.resize(n);
+    }
+
+    float MFFrozenGraph::expected_coverage(const int n, const float scale) const
+    {
+        float out = 0.;
+        for (int i = out_first[n]; i < out_first[n + 1]; ++i) {
+            const int a = out_arcs[i];
+            out += flow[a] * effective_length[a] / scale;
+        }
+        return out;
+    }
+
+    void MFFrozenGraph::heap_move(const std::pair<int, float> &p, const int i)
+    {
+        heap[i] = p;
+        heap_index[p.first] = i;
+    }
+
+    void MFFrozenGraph::heap_bubble_up(int hole, const std::pair<int, float> p)
+    {
+        int parent = (hole - 1) / 2;
+        while (hole > 0 && p.second < heap[parent].second) {
+            heap_move(heap[parent], hole);
+            hole = parent;
+            parent = (hole - 1) / 2;
+        }
+        heap_move(p, hole);
+    }
+
+    void MFFrozenGraph::heap_pop()
+    {
+        // the last item sinks from the top, the smaller child moves up,
+        // the first one on ties
+        const int length = (int) heap.size() - 1;
+        heap_index[heap[0].first] = POST_HEAP;
+        if (length > 0) {
+            const std::pair<int, float> p = heap[length];
+            int hole = 0;
+            int child = 2;
+            while (child < length) {
+                if (heap[child - 1].second < heap[child].second) --child;
+                if (!(heap[child].second < p.second)) break;
+                heap_move(heap[child], hole);
+                hole = child;
+                child = 2 * hole + 2;
+            }
+            if (child >= length) {
+                child--;
+                if (child < length && heap[child].second < p.second) {
+                    heap_move(heap[child], hole);
+                    hole = child;
+                }
+            }
+            heap_move(p, hole);
+        }
+        heap.pop_back();
+    }
+
+    float MFFrozenGraph::min_max_path(const float total, const std::vector<char> &removed, std::vector<int> &path)
+    {
+        const int n = node_count();
+        heap.clear();
+        for (int v = 0; v < n; ++v) {
+            heap_index[v] = PRE_HEAP;
+            dist[v] = 0.;
+            pred[v] = -1;
+        }
+
+        heap.resize(1);
+        heap_bubble_up(0, std::make_pair(source_index, 0.f));
+        while (!heap.empty() && heap[0].first != sink_index) {
+            const int v = heap[0].first;
+            const float d = heap[0].second;
+            dist[v] = d;
+            heap_pop();
+            for (int i = out_first[v]; i < out_first[v + 1]; ++i) {
+                const int a = out_arcs[i];
+                if (removed[a]) continue;
+                const int w = arc_target[a];
+                const float nd = std::max(d, total - flow[a]);
+                if (heap_index[w] == PRE_HEAP) {
+                    heap.resize(heap.size() + 1);
+                    heap_bubble_up((int) heap.size() - 1, std::make_pair(w, nd));
+                    pred[w] = a;
+                } else if (heap_index[w] >= 0 && nd < heap[heap_index[w]].second) {
+                    heap_bubble_up(heap_index[w], std::make_pair(w, nd));
+                    pred[w] = a;
+                }
+            }
+        }
+        if (!heap.empty()) {
+            dist[heap[0].first] = heap[0].second;
+            heap_pop();
+        }
+
+        path.clear();
+        for (int v = sink_index; pred[v] >= 0; v = arc_source[pred[v]]) {
+            path.push_back(pred[v]);
+        }
+        std::reverse(path.begin(), path.end());
+        return dist[sink_index];
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,158 @@
+#include <vector>
+#include <utility>
+
+#include <lemon/list_graph.h>
+
+#ifndef MFFROZENGRAPH_H
+#define MFFROZENGRAPH_H
+
+namespace methylFlow {
+
+    class MFGraph;
+
+    // copy of a component graph once its structure is final (after
+    // MFGraph::regularize), laid out for the phases that only read it:
+    // MFSolver builds the LP and extracts flows, print_regions walks it
+    // and decompose peels paths off its flows.
+    // nodes and arcs are numbered 0..n-1, their attributes are kept in
+    // arrays and the arcs of each node in compressed rows (CSR)
+    //
+    // nodes are numbered in NodeIt order and each node's arcs are kept
+    // in OutArcIt/InArcIt order, so passes over the frozen graph add LP
+    // rows and columns and print regions in the same order as passes
+    // over the ListDigraph did
+    class MFFrozenGraph {
+    public:
+        MFFrozenGraph();
+
+        // copy the structure and attributes of graph
+        void freeze(const MFGraph &graph);
+        void clear();
+
+        int node_count() const;
+        int arc_count() const;
+
+        // index of the source/sink node
+        int source() const;
+        int sink() const;
+
+        // the arcs leaving node are out_arc(i) for out_begin(node) <= i <
+        // out_end(node), likewise for arcs entering it
+        int out_begin(const int node) const;
+        int out_end(const int node) const;
+        int out_arc(const int i) const;
+        int in_begin(const int node) const;
+        int in_end(const int node) const;
+        int in_arc(const int i) const;
+
+        // nodes that are not fake, in the order of MFGraph::fake's
+        // FalseIt, which is the order the LP has its arc rows in
+        const std::vector<int> &real_nodes() const;
+
+        // per node
+        std::vector<lemon::ListDigraph::Node> node;
+        std::vector<char> fake;
+        std::vector<char> childless;
+        std::vector<float> normalized_coverage;
+
+        // per arc
+        std::vector<lemon::ListDigraph::Arc> arc;
+        std::vector<int> arc_source;
+        std::vector<int> arc_target;
+        std::vector<int> effective_length;
+        // set by MFSolver::extract_flows along with MFGraph's flow map
+        std::vector<float> flow;
+
+        // sum of flow * effective length / scale over the arcs leaving
+        // node, as MFGraph::expected_coverage
+        float expected_coverage(const int node, const float scale) const;
+
+        // path from source to sink over the arcs not removed whose
+        // largest total - flow is smallest, the one lemon's Dijkstra
+        // finds with DijkstraMinMaxOperationTraits and its binary heap,
+        // ties included. path gets its arcs from source to sink. returns
+        // the largest total - flow on it, 0 if sink is not reached
+        float min_max_path(const float total, const std::vector<char> &removed, std::vector<int> &path);
+
+    private:
+        int source_index;
+        int sink_index;
+        std::vector<int> out_first;
+        std::vector<int> out_arcs;
+        std::vector<int> in_first;
+        std::vector<int> in_arcs;
+        std::vector<int> real;
+        // node index by node id
+        std::vector<int> index_of;
+
+        // scratch of min_max_path: heap of (node, distance) with each
+        // node's position in it, or PRE_HEAP/POST_HEAP as lemon's BinHeap
+        enum { PRE_HEAP = -1, POST_HEAP = -2 };
+        std::vector<std::pair<int, float> > heap;
+        std::vector<int> heap_index;
+        std::vector<float> dist;
+        std::vector<int> pred;
+
+        void heap_move(const std::pair<int, float> &p, const int i);
+        void heap_bubble_up(int hole, const std::pair<int, float> p);
+        void heap_pop();
+    };
+
+    inline int MFFrozenGraph::node_count() const
+    {
+        return (int) node.size();
+    }
+
+    inline int MFFrozenGraph::arc_count() const
+    {
+        return (int) arc.size();
+    }
+
+    inline int MFFrozenGraph::source() const
+    {
+        return source_index;
+    }
+
+    inline int MFFrozenGraph::sink() const
+    {
+        return sink_index;
+    }
+
+    inline int MFFrozenGraph::out_begin(const int n) const
+    {
+        return out_first[n];
+    }
+
+    inline int MFFrozenGraph::out_end(const int n) const
+    {
+        return out_first[n + 1];
+    }
+
+    inline int MFFrozenGraph::out_arc(const int i) const
+    {
+        return out_arcs[i];
+    }
+
+    inline int MFFrozenGraph::in_begin(const int n) const
+    {
+        return in_first[n];
+    }
+
+    inline int MFFrozenGraph::in_end(const int n) const
+    {
+        return in_first[n + 1];
+    }
+
+    inline int MFFrozenGraph::in_arc(const int i) const
+    {
+        return in_arcs[i];
+    }
+
+    inline const std::vector<int> &MFFrozenGraph::real_nodes() const
+    {
+        return real;
+    }
+
+} // namespace methylFlow
+
+#endif // MFFROZENGRAPH_H
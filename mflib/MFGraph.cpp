@@ -1,19 +1,23 @@
 #include <iostream>
 #include<string>
 #include <stack>
-
-#include <lemon/bfs.h>
-#include <lemon/path.h>
+#include <sstream>
 
 #include "MFGraph.hpp"
 #include "MFRegionPrinter.hpp"
+#include "MFReadSource.hpp"
+#include "MFComponentRunner.hpp"
 
 namespace methylFlow {
     
     MFGraph::MFGraph() : mfGraph(), nodeName_map(mfGraph), coverage_map(mfGraph), normalized_coverage_map(mfGraph), read_map(mfGraph),
     flow_map(mfGraph), effectiveLength_map(mfGraph),
     source(), sink(), fake(mfGraph, false),
-    parentless(mfGraph, false), childless(mfGraph, false), is_normalized(false)
+    parentless(mfGraph, false), childless(mfGraph, false), is_normalized(false),
+    expired_nodes(), duplicate_table(), duplicate_stamp(1), nduplicate_entries(0),
+    duplicate_keys(), nreplaced(0), ncollapsed(0), nskipped(0), ancestor_rows(),
+    ancestor_words(0), nslots(0), free_slots(), reach_bits(), scratch_reached(mfGraph, false),
+    options(), contigs(NULL), ncomponents(0), nclosed_form(0)
     {
     }
     
@@ -40,9 +44,108 @@ namespace methylFlow {
         
         for (std::vector<ListDigraph::Node>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
             if (read_map[*it]) delete read_map[*it];
+            // node ids are reused by the next component
+            childless[*it] = false;
+            parentless[*it] = false;
             mfGraph.erase(*it);
         }
+        // forget the duplicate table by moving to a new stamp
+        if (++duplicate_stamp == 0) {
+            for (std::size_t i = 0; i < duplicate_table.size(); ++i) duplicate_table[i].stamp = 0;
+            duplicate_stamp = 1;
+        }
+        nduplicate_entries = 0;
+        for (std::size_t i = 0; i < duplicate_keys.size(); ++i) delete duplicate_keys[i];
+        duplicate_keys.clear();
+        nreplaced = 0;
+        ncollapsed = 0;
+        nskipped = 0;
+        
+        nslots = 0;
+        free_slots.clear();
+    }
+    
+    int MFGraph::take_slot()
+    {
+        int slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            slot = (int) nslots++;
+            if (nslots > 64 * ancestor_words) {
+                // twice as many slots, rows are twice as long
+                const std::size_t words = ancestor_words ? 2 * ancestor_words : 1;
+                std::vector<uint64_t> rows(64 * words * words, 0);
+                for (std::size_t i = 0; i + 1 < nslots; ++i) {
+                    std::copy(ancestor_rows.begin() + i * ancestor_words,
+                              ancestor_rows.begin() + (i + 1) * ancestor_words,
+                              rows.begin() + i * words);
+                }
+                ancestor_rows.swap(rows);
+                ancestor_words = words;
+            }
+        }
+        std::fill(ancestor_rows.begin() + slot * ancestor_words,
+                  ancestor_rows.begin() + (slot + 1) * ancestor_words, 0);
+        return slot;
+    }
+    
+    void MFGraph::release_slot(const int slot)
+    {
+        if (slot < 0) return;
+        const uint64_t keep = ~((uint64_t) 1 << (slot & 63));
+        for (std::size_t i = slot >> 6; i < nslots * ancestor_words; i += ancestor_words) {
+            ancestor_rows[i] &= keep;
+        }
+        free_slots.push_back(slot);
+    }
+    
+    void MFGraph::add_duplicate_entry(const ListDigraph::Node node, const MethylRead *key, const uint64_t fingerprint)
+    {
+        // keep the table at most half full
+        if (2 * (nduplicate_entries + 1) > duplicate_table.size()) {
+            std::vector<DuplicateSlot> old;
+            old.swap(duplicate_table);
+            DuplicateSlot empty = { 0, NULL, 0, 0, 0 };
+            duplicate_table.assign(old.empty() ? 1024 : 2 * old.size(), empty);
+            const std::size_t mask = duplicate_table.size() - 1;
+            for (std::size_t i = 0; i < old.size(); ++i) {
+                if (old[i].stamp != duplicate_stamp) continue;
+                std::size_t slot = old[i].fingerprint & mask;
+                while (duplicate_table[slot].stamp == duplicate_stamp) slot = (slot + 1) & mask;
+                duplicate_table[slot] = old[i];
+            }
+        }
         
+        const std::size_t mask = duplicate_table.size() - 1;
+        std::size_t slot = fingerprint & mask;
+        while (duplicate_table[slot].stamp == duplicate_stamp && duplicate_table[slot].fingerprint != fingerprint) {
+            slot = (slot + 1) & mask;
+        }
+        DuplicateSlot &entry = duplicate_table[slot];
+        if (entry.stamp != duplicate_stamp) nduplicate_entries++;
+        entry.fingerprint = fingerprint;
+        entry.key = key;
+        entry.stamp = duplicate_stamp;
+        entry.node = mfGraph.id(node);
+        entry.serial = nreplaced;
+    }
+    
+    ListDigraph::Node MFGraph::find_duplicate(const MethylRead *read, const uint64_t fingerprint) const
+    {
+        if (duplicate_table.empty()) return INVALID;
+        const std::size_t mask = duplicate_table.size() - 1;
+        for (std::size_t slot = fingerprint & mask; duplicate_table[slot].stamp == duplicate_stamp; slot = (slot + 1) & mask) {
+            const DuplicateSlot &entry = duplicate_table[slot];
+            if (entry.fingerprint != fingerprint) continue;
+            // a replaced read may be the key, it is gone
+            if (entry.serial != nreplaced) return INVALID;
+            // fingerprints may collide
+            if (!entry.key->isDuplicate(read)) return INVALID;
+            return mfGraph.nodeFromId(entry.node);
+        }
+        return INVALID;
     }
     
     ListDigraph::Node MFGraph::addNode(const std::string name, const int coverage, MethylRead *read)
@@ -103,13 +206,39 @@ namespace methylFlow {
         return out;
     }
     
+    std::string MFGraph::chr_label(const int chr) const
+    {
+        if (contigs && !contigs->empty()) return contigs->label(chr);
+        std::ostringstream label;
+        label << chr;
+        return label.str();
+    }
+    
     void MFGraph::print_regions( std::ostream & region_stream,
-                                const float scale_mult, const int componentId, int chr )
+                                const float scale_mult, const int componentId, const std::string &chr )
     {
-        MFRegionPrinter regionPrinter(this, &region_stream, componentId, scale_mult, chr);
-        BfsVisit<ListDigraph, MFRegionPrinter, BfsVisitDefaultTraits<ListDigraph> > bfs(mfGraph, regionPrinter);
-        
-        bfs.run(source);
+        MFRegionPrinter regionPrinter(this, &frozen, &region_stream, componentId, scale_mult, chr);
+        
+        // breadth first from the source, nodes are printed when first
+        // reached as lemon's BfsVisit did
+        const int n = frozen.node_count();
+        std::vector<char> reached(n, false);
+        std::vector<int> queue;
+        queue.reserve(n);
+        
+        queue.push_back(frozen.source());
+        reached[frozen.source()] = true;
+        regionPrinter.reach(frozen.source());
+        for (std::size_t head = 0; head < queue.size(); ++head) {
+            const int u = queue[head];
+            for (int i = frozen.out_begin(u); i < frozen.out_end(u); ++i) {
+                const int v = frozen.arc_target[frozen.out_arc(i)];
+                if (reached[v]) continue;
+                reached[v] = true;
+                regionPrinter.reach(v);
+                queue.push_back(v);
+            }
+        }
     }
     
     // assumes file is sorted by position
@@ -124,220 +253,115 @@ namespace methylFlow {
                      const float epsilon,
                      const bool verbose )
     {
-        std::vector<MethylRead*> mVector;
-        std::string readid, rStrand, methStr, substStr;
-        std::string QNAME, RNAME, CIGAR, RNEXT, SEQ, QUAL, NM, XX, XM, XR, XG;
-        int FLAG, POS, MAPQ, PNEXT, TLEN;
-        std::string input;
-        
-        int rPos, rLen;
-        std::list<ListDigraph::Node> activeSet;
-        
-        ListDigraph::Node node;
-        int rightMostPos = 0;
-        
-        const int READ_LIMIT = 100000000000;
-#ifndef NDEBUG
-        bool check_count = true;
-#else
-        bool check_count = false;
-#endif
-        
-        int count = 0;
-        int componentCount = 0;
-        
-        if (verbose) {
-            std::cout << "[methylFlow] Reading from file " << std::endl;
-        }
-        
-        // print headers to output files
+        MFStreamReadSource source(instream, flag_SAM);
+        return run( source,
+                   comp_stream,
+                   patt_stream,
+                   region_stream,
+                   chr,
+                   flag_SAM,
+                   lambda,
+                   scale_mult,
+                   epsilon,
+                   verbose );
+    }
+    
+    void MFGraph::print_headers( std::ostream & comp_stream,
+                                std::ostream & patt_stream,
+                                std::ostream & region_stream )
+    {
         comp_stream << "chr\tstart\tend\tcid\tnpatterns\ttotal_coverage\ttotal_flow\n";
         
         patt_stream << "chr\tstart\tend\tcid\tpid\tabundance\tmethylpat\n";
         region_stream << "chr\tstart\tend\tcid\trid\traw_coverage\tnorm_coverage\texp_coverage\tmethylpat\n";
-        if(flag_SAM){
-            while (std::getline(instream, input)){
-                std::cerr << "[methylFlow] 0 Discarding lines start with " << input << std::endl;
-                if(input.size() && input[0] !='@') break;
-                
-            }
-        }
-        int lastChr = 0;
-
-        while (!check_count || count < READ_LIMIT) {
-            
-            if(count >0 || !flag_SAM)
-                std::getline( instream, input );
-            count++;
-            if( !instream ) break; // checks end of file
-            MethylRead * m;
-            
-            
-            if(!flag_SAM){
-                // parse tab-separated line
-                std::istringstream buffer(input);
-                buffer >> readid >> rPos >> rLen >> rStrand >> methStr >> substStr;
-                if ( !buffer || !buffer.eof() ) {
-                    std::cerr << "[methylFlow] Error parsing tsv input" << std::endl;
-                    return -1;
-                }
-                
-                // construct object with read info
-                m = new MethylRead(rPos, rLen);
-                if (methStr != "*"){
-                    m->parseMethyl(methStr);
-                    mVector.push_back(m);
-                }
-                
-#ifndef NDEBUG
-                std::cout << "read: " << readid << " " << m->getString() << std::endl;
-#endif
-            }
-            else if(flag_SAM){
-                //parse SAM format
-                std::istringstream buffer(input);
-                buffer >> QNAME >> FLAG >> RNAME >> POS >> MAPQ >> CIGAR >> RNEXT >> PNEXT >> TLEN >> SEQ >> QUAL >> NM >> XX >> XM >> XR >> XG;
-                if ( !buffer || !buffer.eof() ) {
-                    std::cerr << "[methylFlow] Error parsing SAM input" << std::endl;
-                    return -1;
-                }
-                //parse chr name
-                std::string::size_type sz;
-                std::string chromosome =  RNAME.substr(3);
-                chr = atoi(chromosome.c_str());
-                
-                std::cout << "chr " << chr << std::endl;
-                std::cout << "str " << XM << std::endl;
-                std::cout << "pos " << POS << std::endl;
-                rPos = POS;
-                rLen = SEQ.length();
-                //rLen = findLength(QNAME);
-                std::cout << "rLen " << rLen << std::endl;
-                // construct object with read info
-                m = new MethylRead(rPos, rLen);
-                if (methStr != "*"){
-                    m->parseXMtag(XM);
-                    mVector.push_back(m);
-                    std::cout << "start = " << m->start() << std::endl;
-                    std::cout << "end = " << m->end() << std::endl;
-
-                }
-                
-#ifndef NDEBUG
-                std::cout << "read: " << readid << " " << m->getString() << std::endl;
-#endif
-                //std::cout << "read: " << readid << " " << m->getString() << std::endl;
-                
-            }
-            
-            // we assume the input file is sorted
-            //sort(mVector.begin(), mVector.end(), CompareReadStarts());
-            //for(unsigned int i = 0; i < mVector.size(); i++){
-            //MethylRead * m;
-            //m = mVector.at(i);
-           // std::cout << "read: " << readid << " " << m->getString() << std::endl;
-            
-            // does this read start after the rightMost end position?
-            if (m->start() > rightMostPos || chr != lastChr) {
-                std::cout << "chr " << chr << std::endl;
-                std::cout << "[methylFlow] last chr = " << lastChr << ", chr = " << chr << std::endl;
-
-                lastChr = chr;
-                // clear active reads if necessary
-                if (!activeSet.empty()){
-                    activeSet.clear();
-                }
-                
-                // process this connected component
-                if (count > 1) {
-                    componentCount++;
-                    if (verbose) {
-                        std::cout << "[methylFlow] Processing component " << componentCount << std::endl;
-                        std::cout << "[methylFlow] Read number " << count << std::endl;
-                        std::cout << "[methylFlow] start read " << m->start() << std::endl;
-                        std::cout << "[methylFlow] rightMostPos " << rightMostPos << std::endl;
-                        
-
-                    }
-                    
-                   // count = 0;
-                    run_component( componentCount,
-                                  comp_stream,
-                                  patt_stream,
-                                  region_stream,
-                                  chr,
-                                  flag_SAM,
-                                  lambda,
-                                  scale_mult,
-                                  epsilon,
-                                  verbose );
-                    clear_graph();
-                }
-            }
-            
-            // if no reads in active set, add the node to the graph
-            if (activeSet.empty()) {
-                node = addNode(readid, 1, m);
-                activeSet.push_front(node);
-                
-                // update the right-most position
-                rightMostPos = m->end();
-                continue;
-            }
-            
-            // add read to graph
-            if (processRead(m, readid, &activeSet) && m->end() > rightMostPos) {
-                rightMostPos = m->end();
-            }
-        }
-        
-        componentCount++;
-        if (verbose)
-        {
-            std::cout << "[methylFlow] Processing last component " << componentCount << std::endl;
-            std::cout << "[methylFlow] Read number " << count << std::endl;
-        }
-        run_component( componentCount,
-                      comp_stream,
-                      patt_stream,
-                      region_stream,
-                      chr,
-                      flag_SAM,
-                      lambda,
-                      scale_mult,
-                      epsilon,
-                      verbose );
-        clear_graph();
-        return 0;
+    }
+    
+    // assumes reads are sorted by position
+    int MFGraph::run( MFReadSource & source,
+                     std::ostream & comp_stream,
+                     std::ostream & patt_stream,
+                     std::ostream & region_stream,
+                     int chr,
+                     const bool flag_SAM,
+                     const float lambda,
+                     const float scale_mult,
+                     const float epsilon,
+                     const bool verbose )
+    {
+        MFComponentRunner runner(1);
+        runner.set_solver_options(options);
+        int res = runner.run( source,
+                              comp_stream,
+                              patt_stream,
+                              region_stream,
+                              chr,
+                              flag_SAM,
+                              lambda,
+                              scale_mult,
+                              epsilon,
+                              verbose );
+        ncomponents = runner.component_count();
+        nclosed_form = runner.closed_form_count();
+        return res;
     }
     
     
-    bool MFGraph::processRead(MethylRead *read, const std::string readid, std::list<ListDigraph::Node> *pactiveSet)
+    bool MFGraph::processRead(MethylRead *read, const std::string readid, MFActiveSet *pactiveSet)
     {
+        MFActiveSet &active = *pactiveSet;
 #ifndef NDEBUG
         std::cout << "processing read " << readid << std::endl;
         std::cout << "current active set: ";
-        for (std::list<ListDigraph::Node>::iterator it = pactiveSet->begin(); it != pactiveSet->end(); ++it) {
-            std::cout << nodeName_map[*it] << " ";
+        for (std::size_t i = active.begin(); i != active.end(); ++i) {
+            if (!active.removed(i)) std::cout << nodeName_map[active[i].node] << " ";
         }
         std::cout << std::endl;
 #endif
         
-        // search for identical/superread/subread from left side of active set
-        for (std::list<ListDigraph::Node>::iterator it = pactiveSet->begin(); it != pactiveSet->end(); ) {
-            ListDigraph::Node active_node = *it;
-            if (read_map[active_node]->start() > read->start()) {
-                // we're done here
-                break;
+        // remove nodes from active set since no more possible overlaps
+        // to be found, their reads end before this one starts
+        expired_nodes.clear();
+        active.expire(read->start(), expired_nodes);
+        for (std::vector<MFActiveSet::Entry>::iterator it = expired_nodes.begin(); it != expired_nodes.end(); ++it) {
+#ifndef NDEBUG
+            std::cout << "removing from active set " << nodeName_map[it->node] << std::endl;
+#endif
+            release_slot(it->slot);
+        }
+        
+        // the scan below stops at the same node for an exact duplicate
+        // of an earlier read, nothing before that node in the active set
+        // has changed since (see duplicate_table)
+        const uint64_t fingerprint = read->fingerprint();
+        ListDigraph::Node duplicate = find_duplicate(read, fingerprint);
+        if (duplicate != INVALID) {
+            coverage_map[duplicate] += 1;
+            ncollapsed++;
+            // the scan would have gone up to the node, which is still
+            // active as its read covers this one
+            const int start = read_map[duplicate]->start();
+            for (std::size_t i = active.upper_bound(start - 1); i != active.end(); ++i) {
+                if (active[i].node == duplicate) {
+                    nskipped += i - active.begin() + 1;
+                    break;
+                }
             }
-            
-            ReadComparison cmp = read_map[active_node]->compare(read);
+            delete read;
+            return false;
+        }
+        
+        // search for identical/superread/subread from left side of active set
+        // up to the last node starting with or before this read
+        const std::size_t last = active.upper_bound(read->start());
+        for (std::size_t i = active.begin(); i != last; ++i) {
+            if (active.removed(i)) continue;
+            ListDigraph::Node active_node = active[i].node;
+            ReadComparison cmp = active[i].read->compare(read);
             
 #ifndef NDEBUG
             std::cout << "checking for identical " << nodeName_map[active_node] << std::endl;
 #endif
             
-            bool erased = false;
             switch(cmp) {
                 case IDENTICAL:
                 case SUBREAD:
@@ -347,6 +371,11 @@ namespace methylFlow {
 #ifndef NDEBUG
                     std::cout << "found!" << std::endl;
 #endif
+                    // the node keeps its own read, this one is kept
+                    // until the graph is cleared as the key of its
+                    // duplicates
+                    duplicate_keys.push_back(read);
+                    add_duplicate_entry(active_node, read, fingerprint);
                     return false;
                 case SUPERREAD:
                     // replace read info of corresponding node
@@ -354,25 +383,19 @@ namespace methylFlow {
                     coverage_map[active_node] += 1;
                     if (read_map[active_node]) delete read_map[active_node];
                     read_map[active_node] = read;
+                    active.set_read(i, read);
+                    nreplaced++;
+                    add_duplicate_entry(active_node, read, fingerprint);
 #ifndef NDEBUG
                     std::cout << "found!" << std::endl;
 #endif
                     return false;
                 case METHOVERLAP:
                 case OVERLAP:
-                    // keep going
-                    break;
                 case NONE:
-                    // remove node from active set since no more possible overlaps to be found
-#ifndef NDEBUG
-                    std::cout << "removing from active set " << nodeName_map[active_node] << std::endl;
-#endif
-                    it = pactiveSet->erase(it);
-                    erased = true;
-                default:
+                    // keep going, there are no NONE nodes left
                     break;
             }
-            if (!erased) ++it;
         }
         
         
@@ -386,23 +409,23 @@ namespace methylFlow {
         
         // now we search for all consistent overlaps from the right
         // if a consistent overlap is found, an arc is added
-        // all reachable nodes are marked to avoid extra arc
-        ListDigraph::NodeMap<bool> reachable(mfGraph, false);
-        for (std::list<ListDigraph::Node>::reverse_iterator rit = pactiveSet->rbegin(); rit != pactiveSet->rend(); ++rit) {
-            ListDigraph::Node active_node = *rit;
+        // nodes that reach an added arc are marked to avoid extra arcs
+        reach_bits.assign(ancestor_words, 0);
+        for (std::size_t i = active.end(); i-- != active.begin(); ) {
+            if (active.removed(i)) continue;
+            ListDigraph::Node active_node = active[i].node;
 #ifndef NDEBUG
             std::cout << "comparing node " << nodeName_map[active_node] << std::endl;
 #endif
             
-            //      if (read_map[active_node]->start() >= read->start()) {
-            //	// we're done
-            //	#ifndef NDEBUG
-            //	std::cout << "got to left-most point" << std::endl;
-            //	#endif
-            //	break;
-            //      }
-            //
-            if (reachable[active_node]) {
+            // the first node of a component is added without a slot
+            if (active[i].slot < 0) {
+                active[i].slot = take_slot();
+                reach_bits.resize(ancestor_words, 0);
+            }
+            const int slot = active[i].slot;
+            
+            if (reach_bits[slot >> 6] & ((uint64_t) 1 << (slot & 63))) {
                 // this node is reachable so ignore
 #ifndef NDEBUG
                 std::cout << "reachable" << std::endl;
@@ -410,7 +433,7 @@ namespace methylFlow {
                 continue;
             }
             
-            ReadComparison cmp = read_map[active_node]->compare(read);
+            ReadComparison cmp = active[i].read->compare(read);
             switch(cmp) {
                 case METHOVERLAP:
 #ifndef NDEBUG
@@ -418,51 +441,12 @@ namespace methylFlow {
 #endif
                     
                     // add arc since this is a consistent overlap to a node that is not reached
-                    addArc(active_node, new_node, read->start() - read_map[active_node]->start());
+                    addArc(active_node, new_node, read->start() - active[i].start);
                     
-                    // now mark all new reachable nodes
-                    // scanning active set from left
-                    for (std::list<ListDigraph::Node>::iterator it = pactiveSet->begin(); &*it != &*rit; ++it) {
-                        ListDigraph::Node search_node = *it;
-                        
-#ifndef NDEBUG
-                        std::cout << "is this node reachable" << nodeName_map[search_node] << std::endl;
-#endif
-                        
-                        if (reachable[search_node]) {
-                            // this node is already reachable so skip
-#ifndef NDEBUG
-                            std::cout << "it is, skip" << std::endl;
-#endif
-                            continue;
-                        }
-                        
-                        // see if we can reach this node
-#ifndef NDEBUG
-                        std::cout << "try bfs" << std::endl;
-#endif
-                        
-                        Bfs<ListDigraph> bfs(mfGraph);
-                        reachable[search_node] = bfs.run(search_node, new_node);
-                        if (reachable[search_node]) {
-#ifndef NDEBUG
-                            std::cout << "reached! mark all the rest" << std::endl;
-#endif
-                            
-                            // we reached it, so
-                            // now mark all nodes in the path
-                            Path<ListDigraph> path = bfs.path(new_node);
-                            for (PathNodeIt<Path<ListDigraph> > reachable_node(mfGraph, path); reachable_node != INVALID; ++reachable_node) {
-#ifndef NDEBUG
-                                std::cout << nodeName_map[reachable_node] << " ";
-#endif
-                                
-                                reachable[reachable_node] = true;
-                            }
-#ifndef NDEBUG
-                            std::cout << std::endl;
-#endif
-                        }
+                    // now mark the node and all active nodes reaching it
+                    reach_bits[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+                    for (std::size_t w = 0, row = slot * ancestor_words; w < ancestor_words; ++w) {
+                        reach_bits[w] |= ancestor_rows[row + w];
                     }
                     break;
                 case OVERLAP:
@@ -483,9 +467,15 @@ namespace methylFlow {
             }
         }
         
+        // the active nodes reaching the new node are its row
+        const int new_slot = take_slot();
+        std::copy(reach_bits.begin(), reach_bits.end(), ancestor_rows.begin() + new_slot * ancestor_words);
+        add_duplicate_entry(new_node, read, fingerprint);
+        
         // since we're here we added a node
         // now add it to the active set
-        pactiveSet->push_back(new_node);
+        MFActiveSet::Entry &new_entry = active.push_back(new_node, read);
+        new_entry.slot = new_slot;
         
 #ifndef NDEBUG
         std::cout << std::endl << std::endl;
@@ -507,72 +497,91 @@ namespace methylFlow {
         mfGraph.contract(v, u);
     }
     
+    // the arc out of node if it has exactly one, INVALID otherwise
+    static ListDigraph::Arc single_out_arc(const ListDigraph &g, const ListDigraph::Node node)
+    {
+        ListDigraph::OutArcIt arc(g, node);
+        if (arc == INVALID) return INVALID;
+        const ListDigraph::Arc out = arc;
+        return ++arc == INVALID ? out : ListDigraph::Arc(INVALID);
+    }
+    
+    static bool single_in_arc(const ListDigraph &g, const ListDigraph::Node node)
+    {
+        ListDigraph::InArcIt arc(g, node);
+        return arc != INVALID && ++arc == INVALID;
+    }
+    
     void MFGraph::merge_chains()
     {
         std::stack<ListDigraph::Node> stack;
+        std::vector<ListDigraph::Node> chain;
+        std::vector<MethylRead *> chain_reads;
+        std::vector<ListDigraph::Node> children;
         stack.push(source);
-        bool doagain = false;
-        ListDigraph::NodeMap<bool> reached(mfGraph, false);
+        scratch_reached.reset();
         
         while (!stack.empty()) {
             // grab and pop next node to process
             ListDigraph::Node curNode = stack.top();
             stack.pop();
+            if (scratch_reached[curNode]) continue;
             
-            // check if out degree == 1 (and not a fake node)
-            if (countOutArcs(mfGraph, curNode) == 1 && !fake[curNode]) {
-                // grab the target of single arc
-                ListDigraph::OutArcIt arc(mfGraph, curNode);
-                ListDigraph::Node otherNode = mfGraph.target(arc);
-                
-                // check if target has single parent and is not fake
-                if (countInArcs(mfGraph, otherNode) == 1 && !fake[otherNode]) {
-                    // we can merge these nodes
-                    doagain = true;
+            // follow single arcs (not from a fake node) to nodes with a
+            // single parent (and not fake), these are merged into the
+            // current node in one go
+            chain.clear();
+            if (!fake[curNode]) {
+                ListDigraph::Node last = curNode;
+                ListDigraph::Arc arc;
+                while ((arc = single_out_arc(mfGraph, last)) != INVALID) {
+                    ListDigraph::Node otherNode = mfGraph.target(arc);
+                    if (fake[otherNode] || !single_in_arc(mfGraph, otherNode)) break;
+                    chain.push_back(otherNode);
+                    last = otherNode;
+                }
+            }
+            
+            if (!chain.empty()) {
+                chain_reads.clear();
+                for (std::vector<ListDigraph::Node>::iterator it = chain.begin(); it != chain.end(); ++it) {
 #ifndef NDEBUG
-                    std::cout << "Merging nodes: " << nodeName_map[curNode] << " " << nodeName_map[otherNode] << std::endl;
+                    std::cout << "Merging nodes: " << nodeName_map[curNode] << " " << nodeName_map[*it] << std::endl;
 #endif
-                    
                     // add coverage to current node
-                    coverage_map[curNode] += coverage_map[otherNode];
-                    normalized_coverage_map[curNode] += normalized_coverage_map[otherNode];
-                    
-                    // merge methylation patterns
-                    read_map[curNode]->merge(read_map[otherNode]);
-                    
-                    // delete read object for target node
-                    if (read_map[otherNode]) delete read_map[otherNode];
-                    
-                    // connect current node to children of target node
-                    for (ListDigraph::OutArcIt arc2(mfGraph, otherNode); arc2 != INVALID; ++arc2) {
-                        addArc(curNode, mfGraph.target(arc2), 1);
-                    }
-                    // remove the target node
-                    mfGraph.erase(otherNode);
+                    coverage_map[curNode] += coverage_map[*it];
+                    normalized_coverage_map[curNode] += normalized_coverage_map[*it];
+                    chain_reads.push_back(read_map[*it]);
                 }
-            }
-            
-            if (doagain) {
-                // push current node to stack again
-                stack.push(curNode);
-                doagain = false;
-            } else {
-                reached[curNode] = true;
-                // push children of current node to stack
-                for (ListDigraph::OutArcIt arc(mfGraph, curNode); arc != INVALID; ++arc) {
-                    ListDigraph::Node otherNode = mfGraph.target(arc);
-                    if (!reached[otherNode]) stack.push(otherNode);
+                
+                // merge methylation patterns
+                read_map[curNode]->merge(chain_reads);
+                
+                children.clear();
+                for (ListDigraph::OutArcIt arc(mfGraph, chain.back()); arc != INVALID; ++arc) {
+                    children.push_back(mfGraph.target(arc));
+                }
+                
+                // delete read objects and remove the merged nodes, in
+                // chain order as when merging them one at a time
+                for (std::vector<ListDigraph::Node>::iterator it = chain.begin(); it != chain.end(); ++it) {
+                    if (read_map[*it]) delete read_map[*it];
+                    mfGraph.erase(*it);
+                }
+                
+                // connect current node to children of the last one
+                for (std::vector<ListDigraph::Node>::iterator it = children.begin(); it != children.end(); ++it) {
+                    int length = 1;
+                    if (read_map[*it]) length = read_map[*it]->start() - read_map[curNode]->start();
+                    addArc(curNode, *it, length);
                 }
             }
-        }
-        
-        // fix the effective lengths
-        for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
-            ListDigraph::Node source = mfGraph.source(arc);
-            ListDigraph::Node target = mfGraph.target(arc);
             
-            if (read_map[source] && read_map[target]) {
-                effectiveLength_map[arc] = read_map[target]->start() - read_map[source]->start();
+            scratch_reached.set(curNode, true);
+            // push children of current node to stack
+            for (ListDigraph::OutArcIt arc(mfGraph, curNode); arc != INVALID; ++arc) {
+                ListDigraph::Node otherNode = mfGraph.target(arc);
+                if (!scratch_reached[otherNode]) stack.push(otherNode);
             }
         }
         
@@ -646,7 +655,13 @@ namespace methylFlow {
             std::cout << "[methylFlow] Component " << componentID << " regions created" << std::endl;
         }
         // solve
-        int res = solve( lambda, scale_mult, epsilon, verbose );
+        int res;
+        if (closed_form(lambda, scale_mult)) {
+            res = solve_closed_form( lambda, scale_mult, epsilon, verbose );
+            nclosed_form++;
+        } else {
+            res = solve( lambda, scale_mult, epsilon, verbose );
+        }
         if (res) {
             std::cerr << "[methylFlow] Error solving" << std::endl;
             return res;
@@ -655,7 +670,8 @@ namespace methylFlow {
         if (verbose) {
             std::cout << "[methylFlow] Component " << componentID << " estimation complete. Writing regions to file." << std::endl;
         }
-        print_regions( region_stream, scale_mult, componentID, chr );
+        const std::string label = chr_label(chr);
+        print_regions( region_stream, scale_mult, componentID, label );
         
 #ifndef NDEBUG
         print_graph();
@@ -664,7 +680,7 @@ namespace methylFlow {
         // decompose
         float tflow = total_flow();
         int tcov = total_coverage();
-        int npatterns = decompose(componentID, patt_stream, chr);
+        int npatterns = decompose(componentID, patt_stream, label);
         
         if (verbose) {
             std::cout << "[methylFlow] Component " << componentID << " wrote " << npatterns << " patterns to file." << std::endl;
@@ -673,10 +689,9 @@ namespace methylFlow {
         int start = read(source)->start() + 1;
         int end = read(sink)->end();
         
-        comp_stream << chr << "\t" << start << "\t" << end;
+        comp_stream << label << "\t" << start << "\t" << end;
         comp_stream << "\t" << componentID << "\t" << npatterns;
         comp_stream << "\t" << tcov << "\t" << tflow << std::endl;
-        std::cout << "[methylFlow] Finished processing component " << componentID << std::endl;
         return 0;
     }
 } // namespace MethylFlow
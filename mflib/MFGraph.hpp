@@ -6,6 +6,10 @@
 #include <lemon/lp.h>
 
 #include "MethylRead.hpp"
+#include "MFScratchMap.hpp"
+#include "MFActiveSet.hpp"
+#include "MFFrozenGraph.hpp"
+#include "MFSolverOptions.hpp"
 
 using namespace lemon;
 
@@ -14,9 +18,14 @@ using namespace lemon;
 
 namespace methylFlow {
   class MFSolver;
+  class MFReadSource;
+  class MFContigs;
+  class MFComponentRunner;
 
 class MFGraph {
   friend class MFSolver;
+  friend class MFComponentRunner;
+  friend class MFFrozenGraph;
 
 public:
   MFGraph();
@@ -75,15 +84,50 @@ public:
 	   const float epsilon,
 	   const bool verbose );
 
+  // run reading from a read source (e.g. memory-mapped tsv)
+  int run( MFReadSource & source,
+	   std::ostream & comp_stream,
+	   std::ostream & patt_stream,
+	   std::ostream & region_stream,
+       int chr,
+       const bool flag_SAM,
+	   const float lambda,
+	   const float scale_mult,
+	   const float epsilon,
+	   const bool verbose );
+
+  // header lines of the output files written by run
+  static void print_headers( std::ostream & comp_stream,
+                             std::ostream & patt_stream,
+                             std::ostream & region_stream );
+
+  // number of components processed by the last run
+  const int &component_count() const;
+
+  // components of the last run solved in closed form, without the LP
+  // (see solve_closed_form)
+  const int &closed_form_count() const;
+
+  // settings of the solver used by run and run_component
+  void set_solver_options(const MFSolverOptions &options);
+  const MFSolverOptions &solver_options() const;
+
+  // reads of the current component added to the coverage of a node
+  // by the duplicate table, without a scan of the active set
+  const long &collapsed_reads() const;
+  // entries of the active set the scan would have gone through for them
+  const long &skipped_entries() const;
+
   // tsv file with readid, pos, length, strand (ignored), methylString, subString
-  bool processRead(MethylRead *read, const std::string readid, std::list<ListDigraph::Node> *pactiveSet);
+  // the graph takes read and frees it when cleared
+  bool processRead(MethylRead *read, const std::string readid, MFActiveSet *pactiveSet);
 
   // print the graph
   void print_graph();
 
   void print_regions( std::ostream & region_stream,
 		      const float scale_mult, 
-		      const int componentId, int chr );
+		      const int componentId, const std::string &chr );
   
   // clear graph, delete pointers to read/region objects
   void clear_graph();
@@ -104,9 +148,80 @@ protected:
   ListDigraph::NodeMap<bool> parentless;
   ListDigraph::NodeMap<bool> childless;
 
+  // add nodes for regularization penalty
+  void regularize();
+
+  // solve wrapper
+  int solve(const float lambda, const float length_mult, const float epsilon, const bool verbose);
+
 private:
   bool is_normalized;
 
+  std::vector<MFActiveSet::Entry> expired_nodes;
+
+  // reads of the current component by fingerprint, with the node the
+  // scan of the active set stopped at, so exact duplicates are counted
+  // without a scan. the key is the node's read, or the first read that
+  // was covered by it. an entry is used only while no node has had its
+  // read replaced since it was added: until then the scan would stop
+  // at the same node. slots of earlier components have an older stamp
+  struct DuplicateSlot {
+    uint64_t fingerprint;
+    const MethylRead *key;
+    int node;
+    unsigned int stamp;
+    unsigned long serial;
+  };
+  std::vector<DuplicateSlot> duplicate_table;
+  unsigned int duplicate_stamp;
+  std::size_t nduplicate_entries;
+  // covered reads used as keys, every one of them is kept until
+  // clear_graph even if it never matches a duplicate
+  std::vector<MethylRead *> duplicate_keys;
+  unsigned long nreplaced; // reads replaced by a superread
+  long ncollapsed;
+  long nskipped;
+
+  // enter key, with the given fingerprint, as a read the scan stops at node
+  void add_duplicate_entry(const ListDigraph::Node node, const MethylRead *key, const uint64_t fingerprint);
+  // node the scan would stop at for read, INVALID if not known
+  ListDigraph::Node find_duplicate(const MethylRead *read, const uint64_t fingerprint) const;
+
+  // reachability among active nodes for processRead. each active node
+  // has a slot (MFActiveSet::Entry::slot) and a row of bits, one per
+  // slot, set for the active nodes it can be reached from. arcs only go
+  // into the newest node, so a row is final once its node is added.
+  // when a node leaves the active set its bit is cleared from all rows
+  // and its slot reused
+  std::vector<uint64_t> ancestor_rows; // ancestor_words per slot
+  std::size_t ancestor_words;
+  std::size_t nslots;
+  std::vector<int> free_slots;
+  std::vector<uint64_t> reach_bits; // ancestors of the node being added
+
+  // a free slot, its row is empty
+  int take_slot();
+  // the node of slot is no longer active
+  void release_slot(const int slot);
+
+  // the component as solve passes it to MFSolver, print_regions walks
+  // it and decompose peels paths off it, frozen once regularize has
+  // added the lambda nodes
+  MFFrozenGraph frozen;
+
+  // per pass scratch map of merge_chains
+  MFScratchMap<ListDigraph::Node, bool> scratch_reached;
+
+  MFSolverOptions options;
+
+  // contigs of the source of the current run, NULL if it has none
+  const MFContigs *contigs;
+  int ncomponents;
+  int nclosed_form;
+
+  // text printed in the chr column of output files
+  std::string chr_label(const int chr) const;
+
   // run on current component
   const int run_component( const int componentID,
 			   std::ostream & comp_stream,
@@ -132,15 +247,23 @@ private:
   void normalize_coverage();
   float calculate_median(std::vector<float> x);
 
-  // add nodes for regularization penalty
-  void regularize();
+  // whether solve_closed_form takes the component: options allow it,
+  // no arc joins two of its reads (a single read, a chain merged by
+  // merge_chains, or reads that overlap but disagree) and neither lambda
+  // nor a point of the lambda grid is where the optimum is not unique
+  bool closed_form(const float lambda, const float length_mult) const;
 
-  // solve wrapper
-  int solve(const float lambda, const float length_mult, const float epsilon, const bool verbose);
+  // solve such a component without the LP: each read is alone on a
+  // path source -> read -> lambda node -> sink, its term in the
+  // objective is |coverage - flow * length| + lambda * flow with length
+  // the scaled length 1 of the arc to the lambda node, so it takes flow
+  // coverage / length when lambda < length and none when lambda > length.
+  // lambda < 0 is searched on the grid of MFSolver::search_lambda
+  int solve_closed_form(const float lambda, const float length_mult, const float epsilon, const bool verbose);
 
   // run decomposition algorithm
   // componentID: used for printing
-  int decompose(const int componentID, std::ostream & patt_stream, int chr);
+  int decompose(const int componentID, std::ostream & patt_stream, const std::string &chr);
 };
 
 inline const ListDigraph &MFGraph::get_graph() const
@@ -230,6 +353,36 @@ inline ListDigraph &MFGraph::get_graph()
     return is_normalized;
   }
 
+  inline const int &MFGraph::component_count() const
+  {
+    return ncomponents;
+  }
+
+  inline const int &MFGraph::closed_form_count() const
+  {
+    return nclosed_form;
+  }
+
+  inline void MFGraph::set_solver_options(const MFSolverOptions &solver_options)
+  {
+    options = solver_options;
+  }
+
+  inline const MFSolverOptions &MFGraph::solver_options() const
+  {
+    return options;
+  }
+
+  inline const long &MFGraph::collapsed_reads() const
+  {
+    return ncollapsed;
+  }
+
+  inline const long &MFGraph::skipped_entries() const
+  {
+    return nskipped;
+  }
+
 template<typename V>
 struct DijkstraMinMaxOperationTraits {
   typedef V Value;
@@ -1,9 +1,6 @@
 #include <iostream>
 #include <queue>
 
-#include <lemon/path.h>
-#include <lemon/dijkstra.h>
-
 #include "MFGraph.hpp"
 #include "MFSolver.hpp"
 
@@ -173,7 +170,7 @@ namespace methylFlow {
             nodename << "lambda_" << lamcnt;
             ListDigraph::Node newNode = addNode(nodename.str(), 0);
             ListDigraph::Node node = mfGraph.source(arc);
-            ListDigraph::Arc newArc = addArc(node, newNode, 1);
+            addArc(node, newNode, 1);
             
             mfGraph.changeSource(arc, newNode);
             childless[node] = false;
@@ -189,6 +186,7 @@ namespace methylFlow {
             std::cout << "[methylFlow] Extending graph with regularization nodes" << std::endl;
         }
         regularize();
+        frozen.freeze(*this);
         
         for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
 #ifndef NDEBUG
@@ -215,10 +213,97 @@ namespace methylFlow {
     }
     
     
-    int MFGraph::decompose(const int componentID, std::ostream & patt_stream, int chr)
+    bool MFGraph::closed_form(const float lambda, const float length_mult) const
+    {
+        if (!options.closed_form) return false;
+        for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
+            if (!fake[mfGraph.source(arc)] && !fake[mfGraph.target(arc)]) return false;
+        }
+        
+        // at lambda = length every flow up to coverage / length is optimal
+        // and GLPK's choice is kept
+        const float length = float(1) / length_mult;
+        if (lambda >= 0.) return lambda != length;
+        const double powlimit = 6.0;
+        for (double curpow = -powlimit; curpow <= powlimit; curpow+=.5) {
+            if ((float) pow(2., curpow) == length) return false;
+        }
+        return true;
+    }
+    
+    int MFGraph::solve_closed_form(const float lambda, const float length_mult, const float epsilon, const bool verbose)
+    {
+        if (verbose) {
+            std::cout << "[methylFlow] Extending graph with regularization nodes" << std::endl;
+        }
+        regularize();
+        frozen.freeze(*this);
+        if (verbose) {
+            std::cout << "[methylFlow] Solving optimization problem in closed form" << std::endl;
+        }
+        
+        // as MFSolver's scaled length of the arcs into lambda nodes
+        const float length = float(1) / length_mult;
+        
+        float best_lambda = lambda;
+        if (lambda < 0.) {
+            // the deviance is 0 below length, the coverage above it
+            float coverage = 0.;
+            const std::vector<int> &real_nodes = frozen.real_nodes();
+            for (std::size_t j = 0; j < real_nodes.size(); ++j) {
+                coverage += frozen.normalized_coverage[real_nodes[j]];
+            }
+            
+            const double powlimit = 6.0;
+            const float zero_deviance = 0.;
+            float best_deviance = zero_deviance;
+            best_lambda = 0;
+            for (double curpow = -powlimit; curpow <= powlimit; curpow+=.5) {
+                const float current_lambda = pow(2., curpow);
+                const float current_deviance = current_lambda < length ? 0. : coverage;
+                if (current_deviance < 0.00001 || zero_deviance / current_deviance >= 1.0 - epsilon) {
+                    best_deviance = current_deviance;
+                    best_lambda = current_lambda;
+                }
+            }
+            if (verbose) {
+                std::cout << "[methylFlow] best lamda found " << best_lambda << " deviance=" << best_deviance << std::endl;
+            }
+        }
+        
+        // flow through each read and the lambda node below it
+        std::vector<float> through(frozen.node_count(), 0.);
+        const int s = frozen.source();
+        for (int i = frozen.out_begin(s); i < frozen.out_end(s); ++i) {
+            const int v = frozen.arc_target[frozen.out_arc(i)];
+            const int lambda_node = frozen.arc_target[frozen.out_arc(frozen.out_begin(v))];
+            if (best_lambda < length) {
+                through[v] = (double) frozen.normalized_coverage[v] / length;
+            }
+            through[lambda_node] = through[v];
+        }
+        
+        for (int arc = 0; arc < frozen.arc_count(); ++arc) {
+            const int u = frozen.arc_source[arc];
+            frozen.flow[arc] = through[frozen.fake[u] ? frozen.arc_target[arc] : u];
+            flow_map[frozen.arc[arc]] = frozen.flow[arc];
+        }
+        return 0;
+    }
+    
+    int MFGraph::decompose(const int componentID, std::ostream & patt_stream, const std::string &chr)
     {
+        // paths are peeled off the flows of the frozen graph, arcs left
+        // without flow are removed from it
+        std::vector<char> removed(frozen.arc_count(), 0);
+        std::vector<int> path;
+        
         // compute total flow
-        float total_flow = this->total_flow();
+        float total_flow = 0.;
+        const int t = frozen.sink();
+        for (int i = frozen.in_begin(t); i < frozen.in_end(t); ++i) {
+            total_flow += frozen.flow[frozen.in_arc(i)];
+        }
 #ifndef NDEBUG
         std::cout << "total flow:: " << total_flow << std::endl;
 #endif
@@ -229,46 +314,36 @@ namespace methylFlow {
         while (total_flow > 0) {
             
             flownum++;
-            // compute residual flow for each arc
-            ListDigraph::ArcMap<float> residual_flow(mfGraph);
-            for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
-                residual_flow[arc] = (total_flow - flow_map[arc]);
-                if(flow_map[arc] != 0){
 #ifndef NDEBUG
-                    std::cout << "source: " << mfGraph.id(mfGraph.source(arc))<< ", target: " << mfGraph.id(mfGraph.target(arc)) << ", flow: " << flow_map[arc] <<std::endl;
-#endif
+            for (int arc = 0; arc < frozen.arc_count(); ++arc) {
+                if (!removed[arc] && frozen.flow[arc] != 0) {
+                    std::cout << "source: " << mfGraph.id(frozen.node[frozen.arc_source[arc]]) << ", target: " << mfGraph.id(frozen.node[frozen.arc_target[arc]]) << ", flow: " << frozen.flow[arc] << std::endl;
                 }
-                
             }
-#ifndef NDEBUG
             std::cout << "run the min-max dijkstra algorithm " << std::endl;
 #endif
-            // run the min-max dijkstra algorithm
-            ListDigraph::NodeMap<float> dist(mfGraph);
-            Dijkstra<ListDigraph>
-            ::SetOperationTraits<DijkstraMinMaxOperationTraits<float> >
-            ::Create dijkstra(mfGraph, residual_flow);
-            dijkstra.distMap(dist);
-            dijkstra.run(source, sink);
+            // run the min-max dijkstra algorithm on the residual flow of
+            // each arc, total_flow - flow
+            const float dist = frozen.min_max_path(total_flow, removed, path);
 #ifndef NDEBUG
             std::cout << "get the resulting path and it's flow " << std::endl;
 #endif
             // get the resulting path and it's flow
-            Path<ListDigraph> shortestPath = dijkstra.path(sink);
-            float path_flow = total_flow - dijkstra.dist(sink);
+            float path_flow = total_flow - dist;
             
             
             // construct a meth fragment from path here
             // and remove path flow from each arc in path
 #ifndef NDEBUG
-            std::cout << "dijkstra.dist: " << dijkstra.dist(sink) << ", path_flow:" << path_flow << ", total flow: " << total_flow << std::endl;
+            std::cout << "dijkstra.dist: " << dist << ", path_flow:" << path_flow << ", total flow: " << total_flow << std::endl;
 #endif
             MethylRead pattern = MethylRead(*read_map[source]);
-            for(Path<ListDigraph>::ArcIt arc(shortestPath); arc != INVALID; ++arc) {
+            for (std::size_t i = 0; i < path.size(); ++i) {
+                const int arc = path[i];
 #ifndef NDEBUG
-                std::cout << " After finding a path, " << "source: " << mfGraph.id(mfGraph.source(arc))<< ", target: " << mfGraph.id(mfGraph.target(arc)) << ", flow: " << flow_map[arc] << "arc - pathFlow: " << flow_map[arc] - path_flow << std::endl;
+                std::cout << " After finding a path, " << "source: " << mfGraph.id(frozen.node[frozen.arc_source[arc]]) << ", target: " << mfGraph.id(frozen.node[frozen.arc_target[arc]]) << ", flow: " << frozen.flow[arc] << "arc - pathFlow: " << frozen.flow[arc] - path_flow << std::endl;
 #endif
-                ListDigraph::Node s = mfGraph.source(arc);
+                ListDigraph::Node s = frozen.node[frozen.arc_source[arc]];
                 MethylRead *read = read_map[s];
                 if (!read) continue;
                 
@@ -276,11 +351,11 @@ namespace methylFlow {
                     pattern.merge(read_map[s]);
                 }
                 
-                flow_map[arc] -= path_flow;
+                frozen.flow[arc] -= path_flow;
                 
                 // delete arc if no residual flow
-                if (flow_map[arc] < 0.001) {
-                    mfGraph.erase(arc);
+                if (frozen.flow[arc] < 0.001) {
+                    removed[arc] = 1;
                 }
             }
             if(path_flow < 0.005)
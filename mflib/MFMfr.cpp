@@ -0,0 +1,342 @@
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MFMfr.hpp"
+
+namespace methylFlow {
+
+    static inline void put_uint32(std::vector<unsigned char> &out, const unsigned int v)
+    {
+        out.push_back(v & 0xff);
+        out.push_back((v >> 8) & 0xff);
+        out.push_back((v >> 16) & 0xff);
+        out.push_back((v >> 24) & 0xff);
+    }
+
+    static inline unsigned int get_uint32(const unsigned char *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+    }
+
+    static inline void put_varint(std::vector<unsigned char> &out, unsigned int v)
+    {
+        while (v >= 0x80) {
+            out.push_back((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(v);
+    }
+
+    static inline unsigned int zigzag(const int v)
+    {
+        return ((unsigned int) v << 1) ^ (unsigned int) (v >> 31);
+    }
+
+    static inline int unzigzag(const unsigned int v)
+    {
+        return (int) (v >> 1) ^ -(int) (v & 1);
+    }
+
+    // decode a varint, returns false if it runs past end
+    static inline bool get_varint(const unsigned char *&p, const unsigned char *end, unsigned int &v)
+    {
+        v = 0;
+        for (int shift = 0; p < end && shift < 35; shift += 7) {
+            unsigned char b = *p++;
+            v |= (unsigned int) (b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    MFMfrWriter::MFMfrWriter(const std::size_t bsize) : fp(NULL), flags(0), block_size(bsize), block(),
+    block_chr(0), block_reads(0), last_start(0)
+    {
+    }
+
+    MFMfrWriter::~MFMfrWriter()
+    {
+        close();
+    }
+
+    int MFMfrWriter::open(const std::string &filename, const unsigned int f,
+                          const MFContigs *contigs)
+    {
+        close();
+        fp = fopen(filename.c_str(), "wb");
+        if (!fp) return -1;
+
+        flags = f & ~MFR_CONTIGS;
+        if (contigs && !contigs->empty()) flags |= MFR_CONTIGS;
+        std::vector<unsigned char> header(MFR_MAGIC, MFR_MAGIC + sizeof(MFR_MAGIC));
+        put_uint32(header, flags);
+        if (flags & MFR_CONTIGS) {
+            put_uint32(header, contigs->size());
+            for (std::size_t i = 0; i < contigs->size(); ++i) {
+                const std::string &name = contigs->name(i);
+                put_varint(header, name.size());
+                header.insert(header.end(), name.begin(), name.end());
+                put_varint(header, contigs->length(i));
+            }
+        }
+        if (fwrite(&header[0], 1, header.size(), fp) != header.size()) return -1;
+
+        block.clear();
+        block.reserve(block_size + MFR_BLOCK_HEADER_SIZE);
+        block_reads = 0;
+        return 0;
+    }
+
+    int MFMfrWriter::flush()
+    {
+        if (block_reads == 0) return 0;
+
+        std::vector<unsigned char> header;
+        put_uint32(header, block_chr);
+        put_uint32(header, block_reads);
+        put_uint32(header, block.size());
+        if (fwrite(&header[0], 1, header.size(), fp) != header.size() ||
+            fwrite(&block[0], 1, block.size(), fp) != block.size()) {
+            return -1;
+        }
+
+        block.clear();
+        block_reads = 0;
+        return 0;
+    }
+
+    int MFMfrWriter::write(const MethylRead &read, const std::string &readid, const int chr)
+    {
+        if (!fp) return -1;
+        if (block_reads > 0 && (chr != block_chr || block.size() >= block_size)) {
+            if (flush()) return -1;
+        }
+        if (block_reads == 0) {
+            block_chr = chr;
+            last_start = 0;
+        }
+
+        if (flags & MFR_READ_IDS) {
+            put_varint(block, readid.size());
+            block.insert(block.end(), readid.begin(), readid.end());
+        }
+        put_varint(block, zigzag(read.start() - last_start));
+        put_varint(block, read.length());
+        put_varint(block, read.ncpgs());
+        last_start = read.start();
+
+        int last_offset = 0;
+        for (std::size_t i = 0; i < read.ncpgs(); ++i) {
+            put_varint(block, zigzag(read.cpgOffset[i] - last_offset));
+            last_offset = read.cpgOffset[i];
+        }
+
+        std::size_t nbits = block.size();
+        block.resize(nbits + (read.ncpgs() + 7) / 8, 0);
+        for (std::size_t i = 0; i < read.ncpgs(); ++i) {
+            if (read.methyl[i]) block[nbits + i / 8] |= 1 << (i % 8);
+        }
+
+        block_reads++;
+        return 0;
+    }
+
+    int MFMfrWriter::close()
+    {
+        if (!fp) return 0;
+        int res = flush();
+        if (fclose(fp) != 0) res = -1;
+        fp = NULL;
+        return res;
+    }
+
+    MFMfrReadSource::MFMfrReadSource() : fd(-1), flags(0), data(NULL), size(0), cur(NULL), last(NULL),
+    first_block(NULL), contig_dict(), block_start(NULL), block_end(NULL), block_chr(0), block_reads(0), last_start(0)
+    {
+    }
+
+    MFMfrReadSource::~MFMfrReadSource()
+    {
+        close();
+    }
+
+    int MFMfrReadSource::open(const std::string &filename)
+    {
+        close();
+
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return -1;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+            (std::size_t) st.st_size < MFR_HEADER_SIZE) {
+            close();
+            return -1;
+        }
+
+        size = st.st_size;
+        void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close();
+            return -1;
+        }
+        data = static_cast<unsigned char *>(addr);
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        if (memcmp(data, MFR_MAGIC, sizeof(MFR_MAGIC)) != 0) {
+            std::cerr << "[methylFlow] Not an mfr file: " << filename << std::endl;
+            close();
+            return -1;
+        }
+
+        flags = get_uint32(data + sizeof(MFR_MAGIC));
+        cur = data + MFR_HEADER_SIZE;
+        last = data + size;
+        if ((flags & MFR_CONTIGS) && read_contigs() != 0) {
+            std::cerr << "[methylFlow] Error parsing mfr contigs" << std::endl;
+            close();
+            return -1;
+        }
+        first_block = block_start = block_end = cur;
+        block_reads = 0;
+        return 0;
+    }
+
+    void MFMfrReadSource::close()
+    {
+        if (data) munmap(data, size);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        data = NULL;
+        size = 0;
+        cur = last = first_block = block_start = block_end = NULL;
+        block_reads = 0;
+        contig_dict.clear();
+    }
+
+    int MFMfrReadSource::read_contigs()
+    {
+        if (last - cur < 4) return -1;
+        unsigned int ncontigs = get_uint32(cur);
+        cur += 4;
+        for (unsigned int i = 0; i < ncontigs; ++i) {
+            unsigned int name_length, length;
+            if (!get_varint(cur, last, name_length) ||
+                (std::size_t) (last - cur) < name_length) {
+                return -1;
+            }
+            std::string name(reinterpret_cast<const char *>(cur), name_length);
+            cur += name_length;
+            if (!get_varint(cur, last, length) || contig_dict.add(name, length) != (int) i) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    const MFContigs *MFMfrReadSource::contigs() const
+    {
+        return &contig_dict;
+    }
+
+    long MFMfrReadSource::tell()
+    {
+        if (!data) return -1;
+        return (block_reads > 0 ? block_start : cur) - data;
+    }
+
+    int MFMfrReadSource::seek(const long offset)
+    {
+        if (!data || offset < first_block - data || (std::size_t) offset > size) return -1;
+        cur = block_start = block_end = data + offset;
+        block_reads = 0;
+        return 0;
+    }
+
+    int MFMfrReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        if (!data) return -1;
+
+        // move on to the next non-empty block
+        while (block_reads == 0) {
+            if (cur != block_end) {
+                std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+                return -1;
+            }
+            if (cur == last) return 0;
+            if (last - cur < (long) MFR_BLOCK_HEADER_SIZE) {
+                std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+                return -1;
+            }
+            block_start = cur;
+            block_chr = (int) get_uint32(cur);
+            block_reads = get_uint32(cur + 4);
+            std::size_t nbytes = get_uint32(cur + 8);
+            cur += MFR_BLOCK_HEADER_SIZE;
+            if ((std::size_t) (last - cur) < nbytes) {
+                std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+                return -1;
+            }
+            block_end = cur + nbytes;
+            last_start = 0;
+        }
+
+        unsigned int start, length, ncpgs, offset;
+        readid.clear();
+        if (flags & MFR_READ_IDS) {
+            unsigned int id_length;
+            if (!get_varint(cur, block_end, id_length) ||
+                (std::size_t) (block_end - cur) < id_length) {
+                std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+                return -1;
+            }
+            readid.assign(reinterpret_cast<const char *>(cur), id_length);
+            cur += id_length;
+        }
+
+        if (!get_varint(cur, block_end, start) ||
+            !get_varint(cur, block_end, length) ||
+            !get_varint(cur, block_end, ncpgs) ||
+            (std::size_t) (block_end - cur) < ncpgs) {
+            std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+            return -1;
+        }
+        last_start += unzigzag(start);
+
+        read = new MethylRead(last_start, length);
+        read->cpgOffset.resize(ncpgs);
+        read->methyl.resize(ncpgs);
+
+        int last_offset = 0;
+        for (unsigned int i = 0; i < ncpgs; ++i) {
+            if (!get_varint(cur, block_end, offset)) {
+                delete read;
+                std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+                return -1;
+            }
+            last_offset += unzigzag(offset);
+            read->cpgOffset[i] = last_offset;
+        }
+
+        const unsigned char *bits = cur;
+        cur += (ncpgs + 7) / 8;
+        if (cur > block_end) {
+            delete read;
+            std::cerr << "[methylFlow] Error parsing mfr input" << std::endl;
+            return -1;
+        }
+        for (unsigned int i = 0; i < ncpgs; ++i) {
+            read->methyl[i] = (bits[i / 8] >> (i % 8)) & 1;
+        }
+
+        block_reads--;
+        chr = block_chr;
+        return 1;
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,113 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+#include "MFReadSource.hpp"
+
+#ifndef MFMFR_H
+#define MFMFR_H
+
+namespace methylFlow {
+
+    // .mfr: compact binary reads, written once and loaded by repeated runs
+    //
+    // file:  "MFR\1", flags <uint32>, contig table (only with MFR_CONTIGS),
+    //        then blocks up to end of file
+    // contig table: ncontigs <uint32>, then per contig varint name length,
+    //        name bytes and varint sequence length. chr of blocks are ids
+    //        into this table
+    // block: chr <int32>, nreads <uint32>, nbytes <uint32>, nbytes of reads
+    //        (little-endian). all reads in a block belong to chr
+    // read:  varint id length and id bytes (only with MFR_READ_IDS)
+    //        zigzag varint start, as delta from the previous read in the block
+    //        varint length
+    //        varint ncpgs
+    //        ncpgs zigzag varint offsets, each as delta from the previous one
+    //        (ncpgs + 7) / 8 bytes of methylation bits, first CpG in bit 0
+    const char MFR_MAGIC[4] = { 'M', 'F', 'R', 1 };
+    const std::size_t MFR_HEADER_SIZE = 8;
+    const std::size_t MFR_BLOCK_HEADER_SIZE = 12;
+
+    // read ids are stored (they name regions in regions.tsv)
+    const unsigned int MFR_READ_IDS = 1;
+    // the file has a contig table (reads came from SAM/BAM)
+    const unsigned int MFR_CONTIGS = 2;
+
+    // appends reads to an .mfr file, a block is flushed when the
+    // chromosome changes or it reaches block_size bytes
+    class MFMfrWriter {
+    public:
+        MFMfrWriter(const std::size_t block_size = 1 << 20);
+        ~MFMfrWriter();
+
+        // returns 0 on success, read ids are dropped unless
+        // flags has MFR_READ_IDS. a non-empty contig dictionary is
+        // stored and sets MFR_CONTIGS
+        int open(const std::string &filename, const unsigned int flags = MFR_READ_IDS,
+                 const MFContigs *contigs = NULL);
+        int write(const MethylRead &read, const std::string &readid, const int chr);
+        // flush the last block, returns 0 on success
+        int close();
+
+    private:
+        MFMfrWriter(const MFMfrWriter &);
+
+        int flush();
+
+        std::FILE *fp;
+        unsigned int flags;
+        std::size_t block_size;
+        std::vector<unsigned char> block;
+        int block_chr;
+        unsigned int block_reads;
+        int last_start;
+    };
+
+    // memory-maps an .mfr file and decodes reads in place
+    class MFMfrReadSource : public MFReadSource {
+    public:
+        MFMfrReadSource();
+        ~MFMfrReadSource();
+
+        // map file, returns 0 on success
+        int open(const std::string &filename);
+        void close();
+
+        // readid is left empty if the file has no read ids
+        int next(MethylRead *&read, std::string &readid, int &chr);
+
+        // positions are those of blocks, seeking restarts the block
+        // holding the next read
+        long tell();
+        int seek(const long offset);
+
+        // contig table of the file, empty without MFR_CONTIGS
+        const MFContigs *contigs() const;
+
+    private:
+        MFMfrReadSource(const MFMfrReadSource &);
+
+        // parse the contig table at cur, returns 0 on success
+        int read_contigs();
+
+        int fd;
+        unsigned int flags;
+        unsigned char *data;
+        std::size_t size;
+        const unsigned char *cur;
+        const unsigned char *last;
+        const unsigned char *first_block;
+        MFContigs contig_dict;
+
+        // current block
+        const unsigned char *block_start;
+        const unsigned char *block_end;
+        int block_chr;
+        unsigned int block_reads;
+        int last_start;
+    };
+
+} // namespace methylFlow
+
+#endif // MFMFR_H
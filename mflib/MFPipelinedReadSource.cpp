@@ -0,0 +1,138 @@
+#include <iostream>
+#include <sched.h>
+#include <time.h>
+
+#include "MFPipelinedReadSource.hpp"
+#include "MFReadArena.hpp"
+
+namespace methylFlow {
+
+    // wait strategy on a full or empty queue: yield the cpu a few
+    // times, then sleep so a thread blocked behind an LP solve
+    // doesn't spin
+    static void backoff(unsigned int &spins)
+    {
+        if (spins++ < 64) {
+            sched_yield();
+        } else {
+            struct timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = 100000;
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    static void delete_batch(MFReadBatch *batch)
+    {
+        for (std::size_t i = 0; i < batch->reads.size(); ++i) {
+            delete batch->reads[i];
+        }
+        delete batch;
+    }
+
+    MFPipelinedReadSource::MFPipelinedReadSource(MFReadSource &s,
+                                                 const std::size_t bsize,
+                                                 const std::size_t queue_batches) :
+    source(s), batch_size(bsize > 0 ? bsize : 1), queue(queue_batches),
+    parser(), started(false), stopping(false), parser_readid(), parser_chr(0),
+    batch(NULL), batch_pos(0)
+    {
+    }
+
+    MFPipelinedReadSource::~MFPipelinedReadSource()
+    {
+        if (started) {
+            __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+            pthread_join(parser, NULL);
+        }
+
+        // reads that were parsed but never consumed
+        if (batch) {
+            for (std::size_t i = 0; i < batch_pos; ++i) batch->reads[i] = NULL;
+            delete_batch(batch);
+        }
+        MFReadBatch *left;
+        while (queue.pop(left)) delete_batch(left);
+    }
+
+    void *MFPipelinedReadSource::parser_main(void *arg)
+    {
+        static_cast<MFPipelinedReadSource *>(arg)->parse();
+        return NULL;
+    }
+
+    void MFPipelinedReadSource::parse()
+    {
+        // reads parsed here are freed on the consumer's threads, the
+        // arena's chunks are released once all their reads are
+        MFReadArena arena;
+        MFReadArena::Scope scope(&arena);
+
+        int status = 1;
+        while (status > 0) {
+            MFReadBatch *b = new MFReadBatch;
+            b->reads.reserve(batch_size);
+            b->readids.reserve(batch_size);
+            b->chrs.reserve(batch_size);
+
+            while (b->reads.size() < batch_size) {
+                MethylRead *m;
+                status = source.next(m, parser_readid, parser_chr);
+                if (status <= 0) break;
+                b->reads.push_back(m);
+                b->readids.push_back(parser_readid);
+                b->chrs.push_back(parser_chr);
+            }
+            b->status = status;
+            arena.publish_stats();
+
+            // backpressure: wait for the consumer to make room
+            unsigned int spins = 0;
+            while (!queue.push(b)) {
+                if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+                    delete_batch(b);
+                    return;
+                }
+                backoff(spins);
+            }
+        }
+    }
+
+    int MFPipelinedReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        if (!started) {
+            // sources that don't carry the chromosome leave the caller's value
+            parser_chr = chr;
+            if (pthread_create(&parser, NULL, parser_main, this) != 0) {
+                std::cerr << "[methylFlow] Error starting parser thread" << std::endl;
+                return -1;
+            }
+            started = true;
+        }
+
+        while (!batch || batch_pos == batch->reads.size()) {
+            if (batch) {
+                // end of input stays in the last batch
+                if (batch->status <= 0) return batch->status;
+                delete batch;
+                batch = NULL;
+            }
+
+            unsigned int spins = 0;
+            while (!queue.pop(batch)) backoff(spins);
+            batch_pos = 0;
+        }
+
+        read = batch->reads[batch_pos];
+        readid.swap(batch->readids[batch_pos]);
+        chr = batch->chrs[batch_pos];
+        batch_pos++;
+        return 1;
+    }
+
+    const MFContigs *MFPipelinedReadSource::contigs() const
+    {
+        return source.contigs();
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,66 @@
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <pthread.h>
+
+#include "MFReadSource.hpp"
+#include "MFSpscQueue.hpp"
+
+#ifndef MFPIPELINEDREADSOURCE_H
+#define MFPIPELINEDREADSOURCE_H
+
+namespace methylFlow {
+
+    // reads parsed by the producer thread, the status of the
+    // source after the last read is passed along with the batch
+    struct MFReadBatch {
+        std::vector<MethylRead *> reads;
+        std::vector<std::string> readids;
+        std::vector<int> chrs;
+        int status; // 1 while the source has more reads, else 0 or -1
+    };
+
+    // runs another read source on a parser thread so parsing overlaps
+    // with graph construction and solving on the calling thread
+    // batches of reads go through a bounded SPSC queue, the parser
+    // waits when it is full so at most queue_batches * batch_size
+    // reads are buffered
+    class MFPipelinedReadSource : public MFReadSource {
+    public:
+        MFPipelinedReadSource(MFReadSource &source,
+                              const std::size_t batch_size = 256,
+                              const std::size_t queue_batches = 64);
+        ~MFPipelinedReadSource();
+
+        // the parser thread is started on the first call
+        int next(MethylRead *&read, std::string &readid, int &chr);
+
+        // those of the wrapped source, complete once a read was returned
+        const MFContigs *contigs() const;
+
+    private:
+        MFPipelinedReadSource(const MFPipelinedReadSource &);
+
+        static void *parser_main(void *arg);
+        void parse();
+
+        MFReadSource &source;
+        std::size_t batch_size;
+        MFSpscQueue<MFReadBatch *> queue;
+
+        pthread_t parser;
+        bool started;
+        bool stopping; // set by the consumer to abandon parsing
+
+        // state of the parser thread
+        std::string parser_readid;
+        int parser_chr;
+
+        // batch being consumed
+        MFReadBatch *batch;
+        std::size_t batch_pos;
+    };
+
+} // namespace methylFlow
+
+#endif // MFPIPELINEDREADSOURCE_H
@@ -0,0 +1,132 @@
+#include "MFReadArena.hpp"
+
+namespace methylFlow {
+
+    // live is biased while the chunk is open, so frees on other threads
+    // can't bring it to zero before the arena has added its count
+    struct MFArenaChunk {
+        long live;
+    };
+
+    static const long OPEN_BIAS = 1L << 40;
+
+    // allocations keep 16 byte alignment, the header in front of each
+    // holds its chunk, NULL for heap memory
+    static const std::size_t HEADER_SIZE = 16;
+    static const std::size_t CHUNK_HEADER_SIZE = (sizeof(MFArenaChunk) + 15) & ~(std::size_t) 15;
+
+    static __thread MFReadArena *current_arena = NULL;
+
+    // updated when arenas publish their counts and chunks are released
+    static MFArenaStats totals = { 0, 0, 0, 0 };
+
+    static inline long load(long *counter)
+    {
+        return __sync_fetch_and_add(counter, 0);
+    }
+
+    MFArenaStats arena_stats()
+    {
+        MFArenaStats stats;
+        stats.allocations = load(&totals.allocations);
+        stats.bytes = load(&totals.bytes);
+        stats.chunks_allocated = load(&totals.chunks_allocated);
+        stats.chunks_released = load(&totals.chunks_released);
+        return stats;
+    }
+
+    static inline void release_chunk(MFArenaChunk *chunk)
+    {
+        ::operator delete(chunk);
+        __sync_fetch_and_add(&totals.chunks_released, 1);
+    }
+
+    MFReadArena::MFReadArena(const std::size_t size) : chunk_size(size), chunk(NULL),
+    cur(NULL), last(NULL), nallocs(0), pending_allocations(0), pending_bytes(0)
+    {
+    }
+
+    MFReadArena::~MFReadArena()
+    {
+        close_chunk();
+    }
+
+    MFReadArena::Scope::Scope(MFReadArena *arena) : previous(current_arena)
+    {
+        current_arena = arena;
+    }
+
+    MFReadArena::Scope::~Scope()
+    {
+        current_arena = previous;
+    }
+
+    void MFReadArena::publish_stats()
+    {
+        if (pending_allocations) __sync_fetch_and_add(&totals.allocations, pending_allocations);
+        if (pending_bytes) __sync_fetch_and_add(&totals.bytes, pending_bytes);
+        pending_allocations = pending_bytes = 0;
+    }
+
+    void MFReadArena::close_chunk()
+    {
+        publish_stats();
+        if (!chunk) return;
+        if (__sync_add_and_fetch(&chunk->live, nallocs - OPEN_BIAS) == 0) {
+            release_chunk(chunk);
+        }
+        chunk = NULL;
+        cur = last = NULL;
+        nallocs = 0;
+    }
+
+    void *MFReadArena::bump(const std::size_t bytes)
+    {
+        const std::size_t n = HEADER_SIZE + ((bytes + 15) & ~(std::size_t) 15);
+        if (n > (std::size_t) (last - cur)) {
+            // larger than a chunk, from the heap
+            if (n > chunk_size - CHUNK_HEADER_SIZE) return NULL;
+
+            close_chunk();
+            chunk = static_cast<MFArenaChunk *>(::operator new(chunk_size));
+            chunk->live = OPEN_BIAS;
+            cur = reinterpret_cast<char *>(chunk) + CHUNK_HEADER_SIZE;
+            last = reinterpret_cast<char *>(chunk) + chunk_size;
+            __sync_fetch_and_add(&totals.chunks_allocated, 1);
+        }
+
+        *reinterpret_cast<MFArenaChunk **>(cur) = chunk;
+        void *p = cur + HEADER_SIZE;
+        cur += n;
+        nallocs++;
+        pending_allocations++;
+        pending_bytes += n;
+        return p;
+    }
+
+    void *MFReadArena::allocate(const std::size_t bytes)
+    {
+        if (current_arena) {
+            void *p = current_arena->bump(bytes);
+            if (p) return p;
+        }
+        char *p = static_cast<char *>(::operator new(HEADER_SIZE + bytes));
+        *reinterpret_cast<MFArenaChunk **>(p) = NULL;
+        return p + HEADER_SIZE;
+    }
+
+    void MFReadArena::release(void *p)
+    {
+        if (!p) return;
+        char *header = static_cast<char *>(p) - HEADER_SIZE;
+        MFArenaChunk *chunk = *reinterpret_cast<MFArenaChunk **>(header);
+        if (!chunk) {
+            ::operator delete(header);
+            return;
+        }
+        if (__sync_sub_and_fetch(&chunk->live, 1) == 0) {
+            release_chunk(chunk);
+        }
+    }
+
+} // namespace methylFlow
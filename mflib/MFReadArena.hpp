@@ -0,0 +1,128 @@
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <vector>
+
+#ifndef MFREADARENA_H
+#define MFREADARENA_H
+
+namespace methylFlow {
+
+    // allocation counts of all arenas, as published by them.
+    // chunks_allocated - chunks_released chunks are in use
+    struct MFArenaStats {
+        long allocations;
+        long bytes;
+        long chunks_allocated;
+        long chunks_released;
+    };
+
+    // counts so far, process wide
+    MFArenaStats arena_stats();
+
+    struct MFArenaChunk;
+
+    // bump allocator for reads and their cpg vectors. reads are parsed in
+    // position order, so the reads of a component fill consecutive chunks
+    // and die together when its graph is cleared. allocations are not
+    // freed one by one: each chunk counts its live allocations and is
+    // released whole once the count drops to zero, whichever thread
+    // frees the last one
+    //
+    // an arena is used by a single thread, the one holding a Scope on it.
+    // MethylRead and MFArenaAllocator take memory from the arena in scope
+    // on the calling thread, or from the heap if there is none
+    //
+    // every allocation, heap ones included, is rounded up to 16 bytes
+    // and carries a 16 byte header naming its chunk. a chunk is freed
+    // only with its last allocation, so a single read that outlives the
+    // others of its chunk keeps the whole chunk, 256 KB by default, in
+    // memory
+    class MFReadArena {
+    public:
+        MFReadArena(const std::size_t chunk_size = 256 << 10);
+        // closes the current chunk, it is released with its last read
+        ~MFReadArena();
+
+        // makes arena the one used by this thread until destroyed
+        class Scope {
+        public:
+            Scope(MFReadArena *arena);
+            ~Scope();
+        private:
+            Scope(const Scope &);
+            MFReadArena *previous;
+        };
+
+        // memory from the arena in scope, or the heap
+        static void *allocate(const std::size_t bytes);
+        // p from allocate, on any thread
+        static void release(void *p);
+
+        // add the counts of this arena to arena_stats(), done when a
+        // chunk is closed and by the owner as often as it likes
+        void publish_stats();
+
+    private:
+        MFReadArena(const MFReadArena &);
+
+        void *bump(const std::size_t bytes);
+        void close_chunk();
+
+        std::size_t chunk_size;
+        MFArenaChunk *chunk;
+        char *cur;
+        char *last;
+        long nallocs; // in the current chunk
+        long pending_allocations;
+        long pending_bytes;
+    };
+
+    // std allocator drawing from MFReadArena::allocate, all instances
+    // are equal so containers can be swapped and copied freely
+    template <class T>
+    class MFArenaAllocator {
+    public:
+        typedef T value_type;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <class U> struct rebind { typedef MFArenaAllocator<U> other; };
+
+        MFArenaAllocator() {}
+        template <class U> MFArenaAllocator(const MFArenaAllocator<U> &) {}
+
+        pointer address(reference x) const { return &x; }
+        const_pointer address(const_reference x) const { return &x; }
+        size_type max_size() const { return std::size_t(-1) / sizeof(T) / 2; }
+
+        pointer allocate(size_type n, const void * = 0)
+        {
+            return static_cast<pointer>(MFReadArena::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(pointer p, size_type)
+        {
+            MFReadArena::release(p);
+        }
+
+        void construct(pointer p, const T &value) { new (static_cast<void *>(p)) T(value); }
+        void destroy(pointer p) { p->~T(); }
+
+        template <class U> bool operator==(const MFArenaAllocator<U> &) const { return true; }
+        template <class U> bool operator!=(const MFArenaAllocator<U> &) const { return false; }
+    };
+
+    // cpg offsets and calls of a read
+    typedef std::vector<int, MFArenaAllocator<int> > MFOffsetVector;
+    typedef std::vector<bool, MFArenaAllocator<bool> > MFCallVector;
+    // bit masks of a read's cpgs and calls
+    typedef std::vector<uint64_t, MFArenaAllocator<uint64_t> > MFMaskVector;
+
+} // namespace methylFlow
+
+#endif // MFREADARENA_H
@@ -0,0 +1,276 @@
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MFReadSource.hpp"
+
+namespace methylFlow {
+
+    // whitespace as seen by operator>> on the tsv fields
+    static inline bool is_blank(const char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // parse a whole token as a signed integer, returns false on anything else
+    static bool parse_int(const char *begin, const char *end, int &out)
+    {
+        bool negative = false;
+        if (begin < end && (*begin == '-' || *begin == '+')) {
+            negative = (*begin == '-');
+            ++begin;
+        }
+        if (begin == end) return false;
+
+        int value = 0;
+        for (; begin < end; ++begin) {
+            if (*begin < '0' || *begin > '9') return false;
+            value = value * 10 + (*begin - '0');
+        }
+        out = negative ? -value : value;
+        return true;
+    }
+
+    MFReadSource::~MFReadSource()
+    {
+    }
+
+    long MFReadSource::tell()
+    {
+        return -1;
+    }
+
+    int MFReadSource::seek(const long offset)
+    {
+        return -1;
+    }
+
+    const MFContigs *MFReadSource::contigs() const
+    {
+        return NULL;
+    }
+
+    MFStreamReadSource::MFStreamReadSource(std::istream &in, const bool sam) : instream(in),
+    flag_SAM(sam), header_skipped(false), input(), contig_dict()
+    {
+    }
+
+    MFStreamReadSource::~MFStreamReadSource()
+    {
+    }
+
+    void MFStreamReadSource::skip_header()
+    {
+        header_skipped = true;
+        while (std::getline(instream, input)){
+            std::cerr << "[methylFlow] 0 Discarding lines start with " << input << std::endl;
+            if(input.size() && input[0] !='@') break;
+            if (input.compare(0, 4, "@SQ\t") == 0) contig_dict.add_header_line(input);
+        }
+    }
+
+    int MFStreamReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        std::string rStrand, methStr, substStr;
+        std::string QNAME, RNAME, CIGAR, RNEXT, SEQ, QUAL, NM, XX, XM, XR, XG;
+        int FLAG, POS, MAPQ, PNEXT, TLEN;
+        int rPos, rLen;
+
+        // the first alignment line is consumed while skipping the header
+        if (flag_SAM && !header_skipped) {
+            skip_header();
+        } else {
+            std::getline( instream, input );
+        }
+        if( !instream ) return 0; // checks end of file
+
+        if(!flag_SAM){
+            // parse tab-separated line
+            std::istringstream buffer(input);
+            buffer >> readid >> rPos >> rLen >> rStrand >> methStr >> substStr;
+            if ( !buffer || !buffer.eof() ) {
+                std::cerr << "[methylFlow] Error parsing tsv input" << std::endl;
+                return -1;
+            }
+
+            // construct object with read info
+            read = new MethylRead(rPos, rLen);
+            if (methStr != "*"){
+                read->parseMethyl(methStr);
+            }
+            return 1;
+        }
+
+        //parse SAM format
+        std::istringstream buffer(input);
+        buffer >> QNAME >> FLAG >> RNAME >> POS >> MAPQ >> CIGAR >> RNEXT >> PNEXT >> TLEN >> SEQ >> QUAL >> NM >> XX >> XM >> XR >> XG;
+        if ( !buffer || !buffer.eof() ) {
+            std::cerr << "[methylFlow] Error parsing SAM input" << std::endl;
+            return -1;
+        }
+        //parse chr name, plain numbers without @SQ header
+        if (contig_dict.empty()) {
+            chr = contig_number(RNAME);
+        } else {
+            chr = contig_dict.find(RNAME);
+            if (chr < 0) {
+                std::cerr << "[methylFlow] Reference " << RNAME << " is not in the SAM header" << std::endl;
+                return -1;
+            }
+        }
+
+#ifndef NDEBUG
+        std::cout << "chr " << chr << std::endl;
+        std::cout << "str " << XM << std::endl;
+        std::cout << "pos " << POS << std::endl;
+#endif
+        rPos = POS;
+        rLen = SEQ.length();
+#ifndef NDEBUG
+        std::cout << "rLen " << rLen << std::endl;
+#endif
+        // construct object with read info
+        read = new MethylRead(rPos, rLen);
+        read->parseXMtag(XM);
+#ifndef NDEBUG
+        std::cout << "start = " << read->start() << std::endl;
+        std::cout << "end = " << read->end() << std::endl;
+#endif
+        return 1;
+    }
+
+    long MFStreamReadSource::tell()
+    {
+        if (!instream) return -1;
+        return (long) instream.tellg();
+    }
+
+    int MFStreamReadSource::seek(const long offset)
+    {
+        // contigs come from the header, read it before skipping past it
+        if (flag_SAM && !header_skipped && offset != 0) skip_header();
+        instream.clear();
+        if (!instream.seekg(offset)) return -1;
+        // a SAM header is skipped again when starting over
+        header_skipped = (offset != 0);
+        return 0;
+    }
+
+    const MFContigs *MFStreamReadSource::contigs() const
+    {
+        return &contig_dict;
+    }
+
+    MFMappedTSVReadSource::MFMappedTSVReadSource() : fd(-1), data(NULL), size(0), cur(NULL), last(NULL)
+    {
+    }
+
+    MFMappedTSVReadSource::~MFMappedTSVReadSource()
+    {
+        close();
+    }
+
+    int MFMappedTSVReadSource::open(const std::string &filename)
+    {
+        close();
+
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return -1;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close();
+            return -1;
+        }
+
+        size = st.st_size;
+        if (size > 0) {
+            void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                close();
+                return -1;
+            }
+            data = static_cast<char *>(addr);
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+
+        cur = data;
+        last = data + size;
+        return 0;
+    }
+
+    void MFMappedTSVReadSource::close()
+    {
+        if (data) munmap(data, size);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        data = NULL;
+        size = 0;
+        cur = last = NULL;
+    }
+
+    long MFMappedTSVReadSource::tell()
+    {
+        if (!data) return -1;
+        return cur < last ? cur - data : size;
+    }
+
+    int MFMappedTSVReadSource::seek(const long offset)
+    {
+        if (!data || offset < 0 || (std::size_t) offset > size) return -1;
+        cur = data + offset;
+        return 0;
+    }
+
+    int MFMappedTSVReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        // readid, pos, length, strand (ignored), methylString, subString (ignored)
+        const int NFIELDS = 6;
+        const char *field[NFIELDS];
+        const char *field_end[NFIELDS];
+
+        if (cur >= last) return 0;
+
+        const char *eol = static_cast<const char *>(memchr(cur, '\n', last - cur));
+        if (!eol) eol = last;
+
+        int nfields = 0;
+        const char *p = cur;
+        while (p < eol) {
+            while (p < eol && is_blank(*p)) ++p;
+            if (p == eol) break;
+            if (nfields == NFIELDS) {
+                nfields++;
+                break;
+            }
+            field[nfields] = p;
+            while (p < eol && !is_blank(*p)) ++p;
+            field_end[nfields++] = p;
+        }
+        cur = eol + 1;
+
+        int rPos, rLen;
+        if ( nfields != NFIELDS || field_end[NFIELDS - 1] != eol ||
+            !parse_int(field[1], field_end[1], rPos) ||
+            !parse_int(field[2], field_end[2], rLen) ) {
+            std::cerr << "[methylFlow] Error parsing tsv input" << std::endl;
+            return -1;
+        }
+
+        readid.assign(field[0], field_end[0]);
+
+        // construct object with read info
+        read = new MethylRead(rPos, rLen);
+        if (field_end[4] - field[4] != 1 || *field[4] != '*') {
+            read->parseMethyl(field[4], field_end[4]);
+        }
+        return 1;
+    }
+
+} // namespace methylFlow
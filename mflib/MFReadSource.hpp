@@ -0,0 +1,85 @@
+#include <string>
+#include <istream>
+#include <cstddef>
+
+#include "MethylRead.hpp"
+#include "MFContigs.hpp"
+
+#ifndef MFREADSOURCE_H
+#define MFREADSOURCE_H
+
+namespace methylFlow {
+
+    // a source of reads consumed by MFGraph::run
+    // next() returns 1 if a read was produced, 0 at end of input
+    // and -1 on a parse error. chr is only updated by sources that
+    // carry the chromosome with each read (e.g. SAM), it is a contig
+    // id if contigs() has a dictionary
+    class MFReadSource {
+    public:
+        virtual ~MFReadSource();
+        virtual int next(MethylRead *&read, std::string &readid, int &chr) = 0;
+
+        // position of the next read for MFRegionIndex, seek() continues
+        // reading from a position returned by tell(). sources that can't
+        // seek return -1 from both
+        virtual long tell();
+        virtual int seek(const long offset);
+
+        // contig dictionary of the input, NULL or empty if reads carry
+        // plain chromosome numbers. it is filled in by the time the
+        // first read is returned and doesn't change afterwards
+        virtual const MFContigs *contigs() const;
+    };
+
+    // reads tsv or SAM lines from an input stream (e.g. stdin)
+    class MFStreamReadSource : public MFReadSource {
+    public:
+        MFStreamReadSource(std::istream &instream, const bool flag_SAM);
+        ~MFStreamReadSource();
+
+        int next(MethylRead *&read, std::string &readid, int &chr);
+        long tell();
+        int seek(const long offset);
+
+        // from the @SQ header lines of SAM input
+        const MFContigs *contigs() const;
+
+    protected:
+        // read the SAM header up to the first alignment line in input
+        void skip_header();
+
+        std::istream &instream;
+        bool flag_SAM;
+        bool header_skipped;
+        std::string input;
+        MFContigs contig_dict;
+    };
+
+    // memory-maps a tsv file and tokenizes each line in place
+    // fields are handed to MethylRead without intermediate string copies
+    class MFMappedTSVReadSource : public MFReadSource {
+    public:
+        MFMappedTSVReadSource();
+        ~MFMappedTSVReadSource();
+
+        // map file, returns 0 on success and -1 if the file
+        // can't be mapped (e.g. it is not a regular file)
+        int open(const std::string &filename);
+        void close();
+
+        int next(MethylRead *&read, std::string &readid, int &chr);
+        long tell();
+        int seek(const long offset);
+
+    private:
+        int fd;
+        char *data;
+        std::size_t size;
+        const char *cur;
+        const char *last;
+    };
+
+} // namespace methylFlow
+
+#endif // MFREADSOURCE_H
@@ -0,0 +1,349 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "MFRegionIndex.hpp"
+
+namespace methylFlow {
+
+    static const char MFI_MAGIC[4] = { 'M', 'F', 'I', 2 };
+
+    int parse_region(const std::string &text, MFRegion &region)
+    {
+        std::size_t colon = text.rfind(':');
+        if (colon == std::string::npos) {
+            if (text.empty()) return -1;
+            region.contig = text;
+            region.chr = -1;
+            region.start = 1;
+            region.end = 0x7fffffff;
+            return 0;
+        }
+
+        std::string range = text.substr(colon + 1);
+        range.erase(std::remove(range.begin(), range.end(), ','), range.end());
+        std::size_t dash = range.find('-');
+        if (colon == 0 || dash == std::string::npos) return -1;
+
+        char *endp;
+        long start = strtol(range.c_str(), &endp, 10);
+        if (endp != range.c_str() + dash) return -1;
+        long end = strtol(range.c_str() + dash + 1, &endp, 10);
+        if (*endp != '\0' || dash + 1 == range.size() || start < 1 || end < start) return -1;
+
+        region.contig = text.substr(0, colon);
+        region.chr = -1;
+        region.start = start;
+        region.end = end;
+        return 0;
+    }
+
+    int read_bed_regions(const std::string &filename, std::vector<MFRegion> &regions)
+    {
+        std::ifstream in(filename.c_str());
+        if (!in) return -1;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#' ||
+                line.compare(0, 5, "track") == 0 || line.compare(0, 7, "browser") == 0) {
+                continue;
+            }
+            std::istringstream buffer(line);
+            std::string name;
+            long start, end;
+            buffer >> name >> start >> end;
+            if (!buffer || start < 0 || end <= start) {
+                std::cerr << "[methylFlow] Error parsing BED line: " << line << std::endl;
+                return -1;
+            }
+            MFRegion region;
+            region.contig = name;
+            region.chr = -1;
+            region.start = start + 1;
+            region.end = end;
+            regions.push_back(region);
+        }
+        return 0;
+    }
+
+    static void put_uint32(std::FILE *fp, const unsigned int v)
+    {
+        unsigned char b[4] = { (unsigned char) v, (unsigned char) (v >> 8),
+                               (unsigned char) (v >> 16), (unsigned char) (v >> 24) };
+        fwrite(b, 1, 4, fp);
+    }
+
+    static bool get_uint32(std::FILE *fp, unsigned int &v)
+    {
+        unsigned char b[4];
+        if (fread(b, 1, 4, fp) != 4) return false;
+        v = b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int) b[3] << 24);
+        return true;
+    }
+
+    MFRegionIndex::MFRegionIndex() : chrs(), names(), offsets()
+    {
+    }
+
+    int MFRegionIndex::build(MFReadSource &source, int chr)
+    {
+        chrs.clear();
+        names.clear();
+        offsets.clear();
+
+        std::string readid;
+        int last_start = 0;
+        while (true) {
+            long offset = source.tell();
+
+            MethylRead *m;
+            int res = source.next(m, readid, chr);
+            if (res <= 0) return res;
+            // streams can't tell at end of a file without final newline
+            if (offset < 0) {
+                delete m;
+                return -1;
+            }
+
+            if (chrs.empty() || chr != chrs.back()) {
+                if (std::find(chrs.begin(), chrs.end(), chr) != chrs.end()) {
+                    std::cerr << "[methylFlow] Input is not sorted, chr " << chr << " appears twice" << std::endl;
+                    delete m;
+                    return -1;
+                }
+                chrs.push_back(chr);
+                offsets.push_back(std::vector<long>());
+
+                // plain chromosome numbers without a contig dictionary
+                const MFContigs *contigs = source.contigs();
+                if (contigs && !contigs->empty()) {
+                    names.push_back(contigs->name(chr));
+                } else {
+                    std::ostringstream number;
+                    number << chr;
+                    names.push_back(number.str());
+                }
+            } else if (m->start() < last_start) {
+                std::cerr << "[methylFlow] Input is not sorted at position " << m->start() << std::endl;
+                delete m;
+                return -1;
+            }
+            last_start = m->start();
+
+            // reads come in file order, the first one seen in a window
+            // has the smallest position
+            std::vector<long> &windows = offsets.back();
+            std::size_t first = std::max(m->start(), 0) >> WINDOW_SHIFT;
+            std::size_t last = std::max(m->end(), m->start()) >> WINDOW_SHIFT;
+            if (windows.size() <= last) windows.resize(last + 1, -1);
+            for (std::size_t w = first; w <= last; ++w) {
+                if (windows[w] < 0) windows[w] = offset;
+            }
+            delete m;
+        }
+    }
+
+    int MFRegionIndex::save(const std::string &filename) const
+    {
+        std::FILE *fp = fopen(filename.c_str(), "wb");
+        if (!fp) return -1;
+
+        fwrite(MFI_MAGIC, 1, sizeof(MFI_MAGIC), fp);
+        put_uint32(fp, chrs.size());
+        for (std::size_t i = 0; i < chrs.size(); ++i) {
+            put_uint32(fp, chrs[i]);
+            put_uint32(fp, names[i].size());
+            fwrite(names[i].data(), 1, names[i].size(), fp);
+            put_uint32(fp, offsets[i].size());
+            for (std::size_t w = 0; w < offsets[i].size(); ++w) {
+                unsigned long long v = offsets[i][w];
+                put_uint32(fp, v & 0xffffffff);
+                put_uint32(fp, v >> 32);
+            }
+        }
+        return (ferror(fp) | fclose(fp)) ? -1 : 0;
+    }
+
+    int MFRegionIndex::load(const std::string &filename)
+    {
+        chrs.clear();
+        names.clear();
+        offsets.clear();
+
+        std::FILE *fp = fopen(filename.c_str(), "rb");
+        if (!fp) return -1;
+
+        char magic[4];
+        unsigned int nchrs = 0;
+        bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, MFI_MAGIC, 4) == 0 &&
+                  get_uint32(fp, nchrs);
+        for (unsigned int i = 0; ok && i < nchrs; ++i) {
+            unsigned int chr, name_length, nwindows;
+            ok = get_uint32(fp, chr) && get_uint32(fp, name_length) && name_length < 4096;
+            if (!ok) break;
+            std::string name(name_length, ' ');
+            ok = fread(&name[0], 1, name_length, fp) == name_length && get_uint32(fp, nwindows);
+            if (!ok) break;
+            chrs.push_back((int) chr);
+            names.push_back(name);
+            offsets.push_back(std::vector<long>(nwindows));
+            for (unsigned int w = 0; ok && w < nwindows; ++w) {
+                unsigned int lo, hi;
+                ok = get_uint32(fp, lo) && get_uint32(fp, hi);
+                if (!ok) break;
+                offsets.back()[w] = (long) (((unsigned long long) hi << 32) | lo);
+            }
+        }
+        fclose(fp);
+
+        if (!ok) {
+            chrs.clear();
+            names.clear();
+            offsets.clear();
+            return -1;
+        }
+        return 0;
+    }
+
+    int MFRegionIndex::chr_rank(const int chr) const
+    {
+        std::vector<int>::const_iterator it = std::find(chrs.begin(), chrs.end(), chr);
+        return it == chrs.end() ? -1 : it - chrs.begin();
+    }
+
+    int MFRegionIndex::find_contig(const std::string &name) const
+    {
+        std::string other = name.compare(0, 3, "chr") == 0 ? name.substr(3) : "chr" + name;
+        std::vector<std::string>::const_iterator it = std::find(names.begin(), names.end(), name);
+        if (it == names.end()) it = std::find(names.begin(), names.end(), other);
+        return it == names.end() ? -1 : chrs[it - names.begin()];
+    }
+
+    long MFRegionIndex::query(const int chr, const int start) const
+    {
+        int rank = chr_rank(chr);
+        if (rank < 0) return -1;
+
+        // reads overlapping start overlap its window, later ones
+        // start in the next window with reads
+        const std::vector<long> &windows = offsets[rank];
+        for (std::size_t w = std::max(start, 0) >> WINDOW_SHIFT; w < windows.size(); ++w) {
+            if (windows[w] >= 0) return windows[w];
+        }
+        return -1;
+    }
+
+    // orders regions by chromosome as found in the indexed file
+    class CompareRegions {
+    public:
+        CompareRegions(const MFRegionIndex &i) : index(i) {}
+        bool operator()(const MFRegion &a, const MFRegion &b) const
+        {
+            int ra = index.chr_rank(a.chr), rb = index.chr_rank(b.chr);
+            if (ra != rb) return ra < rb;
+            return a.start < b.start;
+        }
+    private:
+        const MFRegionIndex &index;
+    };
+
+    MFRegionReadSource::MFRegionReadSource(MFReadSource &s, const MFRegionIndex &i,
+                                           const std::vector<MFRegion> &r) :
+    source(s), index(i), regions(), current(0), positioned(false), started(false),
+    pending(NULL), pending_id(), pending_chr(0), pending_offset(-1)
+    {
+        std::vector<MFRegion> sorted;
+        for (std::size_t k = 0; k < r.size(); ++k) {
+            MFRegion region = r[k];
+            region.chr = index.find_contig(region.contig);
+            if (region.chr >= 0) sorted.push_back(region);
+        }
+        std::sort(sorted.begin(), sorted.end(), CompareRegions(index));
+
+        for (std::size_t k = 0; k < sorted.size(); ++k) {
+            if (!regions.empty() && regions.back().chr == sorted[k].chr &&
+                sorted[k].start <= regions.back().end) {
+                regions.back().end = std::max(regions.back().end, sorted[k].end);
+            } else {
+                regions.push_back(sorted[k]);
+            }
+        }
+    }
+
+    MFRegionReadSource::~MFRegionReadSource()
+    {
+        delete pending;
+    }
+
+    int MFRegionReadSource::next(MethylRead *&read, std::string &readid, int &chr)
+    {
+        while (current < regions.size()) {
+            const MFRegion &region = regions[current];
+
+            // after the first seek go forward only, reads before the current
+            // position were either returned for an earlier region or end
+            // before this one
+            if (!positioned) {
+                long offset = index.query(region.chr, region.start);
+                if (offset < 0) {
+                    current++;
+                    continue;
+                }
+                long here = pending ? pending_offset : source.tell();
+                if (!started || offset > here) {
+                    delete pending;
+                    pending = NULL;
+                    if (source.seek(offset) != 0) {
+                        std::cerr << "[methylFlow] Error seeking in input" << std::endl;
+                        return -1;
+                    }
+                }
+                positioned = true;
+                started = true;
+            }
+
+            if (!pending) {
+                // sources without chromosome information keep the caller's
+                pending_offset = source.tell();
+                pending_chr = chr;
+                int res = source.next(pending, pending_id, pending_chr);
+                if (res <= 0) {
+                    pending = NULL;
+                    return res;
+                }
+            }
+
+            int rank = index.chr_rank(pending_chr);
+            int region_rank = index.chr_rank(region.chr);
+            if (rank < region_rank || (rank == region_rank && pending->end() < region.start)) {
+                delete pending;
+                pending = NULL;
+                continue;
+            }
+
+            if (rank == region_rank && pending->start() <= region.end) {
+                read = pending;
+                readid.swap(pending_id);
+                chr = pending_chr;
+                pending = NULL;
+                return 1;
+            }
+
+            // past this region, keep the read for the next one
+            current++;
+            positioned = false;
+        }
+        return 0;
+    }
+
+    const MFContigs *MFRegionReadSource::contigs() const
+    {
+        return source.contigs();
+    }
+
+} // namespace methylFlow
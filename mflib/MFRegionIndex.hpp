@@ -0,0 +1,104 @@
+#include <string>
+#include <vector>
+
+#include "MethylRead.hpp"
+#include "MFReadSource.hpp"
+
+#ifndef MFREGIONINDEX_H
+#define MFREGIONINDEX_H
+
+namespace methylFlow {
+
+    // genomic region, 1-based inclusive
+    // chr is the contig id found for contig in an index
+    struct MFRegion {
+        std::string contig;
+        int chr;
+        int start;
+        int end;
+    };
+
+    // parse contig:start-end, or contig for a whole contig
+    // returns 0 on success
+    int parse_region(const std::string &text, MFRegion &region);
+
+    // append regions of a BED file (0-based, half-open)
+    // returns 0 on success
+    int read_bed_regions(const std::string &filename, std::vector<MFRegion> &regions);
+
+    // linear index over a coordinate sorted read source (similar to tabix):
+    // for each chromosome and 16kb window, the position of the first read
+    // overlapping the window. contig names are kept to resolve regions
+    class MFRegionIndex {
+    public:
+        static const int WINDOW_SHIFT = 14;
+
+        MFRegionIndex();
+
+        // index all reads of source, chr is used for sources without
+        // chromosome information. returns 0 on success and -1 if source
+        // can't seek or is not sorted
+        int build(MFReadSource &source, int chr);
+
+        int save(const std::string &filename) const;
+        int load(const std::string &filename);
+
+        // position of the first read that may end at or after start on chr,
+        // -1 if there is none
+        long query(const int chr, const int start) const;
+
+        // order of chr in the indexed file, -1 if it has no reads
+        int chr_rank(const int chr) const;
+
+        // chr of a contig name, with or without "chr" prefix,
+        // -1 if it has no reads
+        int find_contig(const std::string &name) const;
+
+    private:
+        std::vector<int> chrs;
+        std::vector<std::string> names;
+        std::vector< std::vector<long> > offsets;
+    };
+
+    // reads of source overlapping a set of regions, seeking with an index
+    // regions are visited in file order, overlapping ones are merged and
+    // those on contigs without reads are dropped
+    class MFRegionReadSource : public MFReadSource {
+    public:
+        MFRegionReadSource(MFReadSource &source, const MFRegionIndex &index,
+                           const std::vector<MFRegion> &regions);
+        ~MFRegionReadSource();
+
+        int next(MethylRead *&read, std::string &readid, int &chr);
+
+        // those of the wrapped source
+        const MFContigs *contigs() const;
+
+        // number of regions left after merging
+        std::size_t nregions() const;
+
+    private:
+        MFRegionReadSource(const MFRegionReadSource &);
+
+        MFReadSource &source;
+        const MFRegionIndex &index;
+        std::vector<MFRegion> regions;
+        std::size_t current;
+        bool positioned;
+        bool started;
+
+        // read following the current region, kept for the next one
+        MethylRead *pending;
+        std::string pending_id;
+        int pending_chr;
+        long pending_offset;
+    };
+
+    inline std::size_t MFRegionReadSource::nregions() const
+    {
+        return regions.size();
+    }
+
+} // namespace methylFlow
+
+#endif // MFREGIONINDEX_H
@@ -1,15 +1,18 @@
 #include <iostream>
 
 #include "MFGraph.hpp"
+#include "MFFrozenGraph.hpp"
 #include "MFRegionPrinter.hpp"
 #include "MethylRead.hpp"
 
 namespace methylFlow {
     
     MFRegionPrinter::MFRegionPrinter( MFGraph * g,
+                                     const MFFrozenGraph * fg,
                                      std::ostream * ostream,
                                      const int cid,
-                                     const float scale, int chr ) : mfGraph(g),
+                                     const float scale, const std::string &chr ) : mfGraph(g),
+    frozen(fg),
     outstream(ostream),
     componentID(cid),
     scale_mult(scale),
@@ -26,16 +29,17 @@ namespace methylFlow {
         return *outstream;
     }
     
-    void MFRegionPrinter::reach(const ListDigraph::Node & node) {
-        if (node == mfGraph->get_source() || node == mfGraph->get_sink()) return;
+    void MFRegionPrinter::reach(const int index) {
+        if (index == frozen->source() || index == frozen->sink()) return;
+        const ListDigraph::Node node = frozen->node[index];
         MethylRead * read = mfGraph->read(node);
         if (!read) return;
         
         getstream() << chromosome << "\t"<< read->start() << "\t" << read->end();
         getstream() << "\t" << componentID << "\t" << mfGraph->node_name(node);
         getstream() << "\t" << mfGraph->coverage(node);
-        getstream() << "\t" << (mfGraph->isNormalized() ? mfGraph->normalized_coverage(node) : 0.);
-        getstream() << "\t" << mfGraph->expected_coverage(node, scale_mult);
+        getstream() << "\t" << (mfGraph->isNormalized() ? frozen->normalized_coverage[index] : 0.);
+        getstream() << "\t" << frozen->expected_coverage(index, scale_mult);
         getstream() << "\t" << read->getMethString() << std::endl;
     }
 } // namespace methylFlow
@@ -1,28 +1,31 @@
-#include <lemon/bfs.h>
-
-using namespace lemon;
+#include <string>
+#include <ostream>
 
 #ifndef MFREGIONPRINTER_H
 #define MFREGIONPRINTER_H
 
 namespace methylFlow {
     class MFGraph;
+    class MFFrozenGraph;
     
-    class MFRegionPrinter : public BfsVisitor<ListDigraph> {
+    // prints a line per node of the frozen graph reached from the source
+    class MFRegionPrinter {
         
         friend class MFGraph;
         
     public:
-        MFRegionPrinter(MFGraph * g, std::ostream * ostream, const int cid, const float scale_mult, int chr);
+        MFRegionPrinter(MFGraph * g, const MFFrozenGraph * fg, std::ostream * ostream, const int cid, const float scale_mult, const std::string &chr);
         ~MFRegionPrinter();
         std::ostream & getstream();
-        void reach (ListDigraphBase::Node const &node);
+        // node: index in the frozen graph
+        void reach (const int node);
     protected:
         MFGraph *mfGraph;
+        const MFFrozenGraph *frozen;
         std::ostream * outstream;
         int componentID;
         float scale_mult;
-        int chromosome;
+        std::string chromosome;
     };
     
 } // namespace methylFlow
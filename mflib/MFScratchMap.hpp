@@ -0,0 +1,75 @@
+#include <vector>
+#include <algorithm>
+
+#include <lemon/list_graph.h>
+
+#ifndef MFSCRATCHMAP_H
+#define MFSCRATCHMAP_H
+
+namespace methylFlow {
+
+    inline int scratch_max_id(const lemon::ListDigraph &graph, const lemon::ListDigraph::Node &)
+    {
+        return graph.maxNodeId();
+    }
+
+    inline int scratch_max_id(const lemon::ListDigraph &graph, const lemon::ListDigraph::Arc &)
+    {
+        return graph.maxArcId();
+    }
+
+    // node or arc map for values used within one pass over the graph,
+    // kept across passes so they don't allocate and fill a map the size
+    // of the graph each time. every value is stamped with the epoch it
+    // was set in and reset() starts a new epoch, values of earlier ones
+    // read as the default. reset() after adding items to the graph
+    //
+    // a lemon ReadWriteMap, e.g. the dist map of a Dijkstra
+    template <typename K, typename V>
+    class MFScratchMap {
+    public:
+        typedef K Key;
+        typedef V Value;
+
+        MFScratchMap(const lemon::ListDigraph &graph, const V &value = V())
+        : graph(&graph), def(value), values(), stamps(), epoch(1)
+        {
+        }
+
+        void reset()
+        {
+            const std::size_t n = scratch_max_id(*graph, K()) + 1;
+            if (stamps.size() < n) {
+                values.resize(n, def);
+                stamps.resize(n, 0);
+            }
+            if (++epoch == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        Value operator[](const Key &key) const
+        {
+            const int i = graph->id(key);
+            return stamps[i] == epoch ? values[i] : def;
+        }
+
+        void set(const Key &key, const Value &value)
+        {
+            const int i = graph->id(key);
+            values[i] = value;
+            stamps[i] = epoch;
+        }
+
+    private:
+        const lemon::ListDigraph *graph;
+        V def;
+        std::vector<V> values;
+        std::vector<unsigned int> stamps;
+        unsigned int epoch;
+    };
+
+} // namespace methylFlow
+
+#endif // MFSCRATCHMAP_H
@@ -1,24 +1,57 @@
+#include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <pthread.h>
 
 #include <lemon/lp.h>
+#include <glpk.h>
 
 #include "MFSolver.hpp"
 
 using namespace lemon;
 
 namespace methylFlow {
+    // grid points [first, last) of search_lambda_parallel, solved on one
+    // copy of the LP. deviance, opt and iterations are shared by the
+    // blocks and indexed by grid point
+    struct MFLambdaBlock {
+        MFSolver *solver;
+        int first;
+        int last;
+        float epsilon;
+        float zero_deviance;
+        std::vector<float> *deviance;
+        std::vector<double> *opt;
+        std::vector<int> *iterations;
+        // the last grid point passing the threshold, or -1
+        int best;
+        // basis the block starts from, that of lambda = 0
+        std::vector<int> row_stat;
+        std::vector<int> col_stat;
+        // bases the block reached at its first and last grid points
+        std::vector<int> first_row_stat;
+        std::vector<int> first_col_stat;
+        std::vector<int> last_row_stat;
+        std::vector<int> last_col_stat;
+        int res;
+    };
+    
     MFSolver::MFSolver(MFGraph *mfobj) : mf(mfobj),
-    alpha(mfobj->get_graph()),
-    beta(mfobj->get_graph()),
-    nu(mfobj->get_graph()),
-    rows(mfobj->get_graph()),
-    scaled_length(mfobj->get_graph())
+    lp(NULL),
+    length_mult(1.),
+    graph(mfobj->frozen),
+    alpha(mfobj->frozen.node_count()),
+    beta(mfobj->frozen.node_count()),
+    nu(mfobj->frozen.node_count()),
+    rows(mfobj->frozen.arc_count()),
+    scaled_length(mfobj->frozen.arc_count()),
+    last_iterations(0)
     {
     }
     
     MFSolver::~MFSolver()
     {
+        delete lp;
     }
     
     int MFSolver::solve(const float lambda, const float length_mult, const float epsilon, const bool verbose)
@@ -35,7 +68,14 @@ namespace methylFlow {
             std::cout << "[methylFlow] Searching for best lambda" << std::endl;
         }
         
-        res = search_lambda(epsilon, best_lambda, verbose);
+        const MFSolverOptions &options = mf->solver_options();
+        if (options.lambda_search == LAMBDA_PATH) {
+            res = search_lambda_path(epsilon, best_lambda, verbose);
+        } else if (options.lambda_threads > 1 && graph.node_count() >= options.lambda_threads_min_nodes) {
+            res = search_lambda_parallel(epsilon, best_lambda, verbose);
+        } else {
+            res = search_lambda(epsilon, best_lambda, verbose);
+        }
         if (res) return res;
         
         return solve_for_lambda(best_lambda);
@@ -55,6 +95,11 @@ namespace methylFlow {
         zero_lambda = 0;
         solve_for_lambda(zero_lambda);
         zero_deviance = get_deviance(zero_lambda);
+        best_deviance = zero_deviance;
+        if (verbose) {
+            std::cout << "lam=0 dev=" << zero_deviance;
+            std::cout << " , iterations = " << iterations() << std::endl;
+        }
         
         for (double curpow = -powlimit; curpow <= powlimit; curpow+=.5) {
             current_lambda = pow(2., curpow);
@@ -64,7 +109,8 @@ namespace methylFlow {
             current_deviance = get_deviance(current_lambda);
             if (verbose) {
                 std::cout << "lam=2^" << curpow << " dev=" << current_deviance;
-                std::cout << " , opt = " <<  lp->primal()  << std::endl;
+                std::cout << " , opt = " <<  lp->primal();
+                std::cout << " , iterations = " << iterations() << std::endl;
             }
             
 
@@ -82,30 +128,342 @@ namespace methylFlow {
         return solve_for_lambda(std::max(0.0, best_lambda-0.00001));
     }
     
-    int MFSolver::make_lp(const float length_mult)
+    // the grid points of search_lambda are solved in contiguous blocks,
+    // the first on this LP and the others by threads on copies of it, all
+    // starting from the basis of lambda = 0 and warm starting along the
+    // block. the best lambda is the last grid point passing the
+    // threshold, as in search_lambda.
+    //
+    // a solve is determined by the basis it starts from, and the flows
+    // of a degenerate component depend on it. so the serial chain of
+    // search_lambda is then followed on this LP: block b joins it when
+    // the chain, carried on from block b - 1, reaches the basis block b
+    // reached at its first grid point. from there on block b solved the
+    // same LPs from the same bases, and the chain jumps to its last
+    // basis. a block that does not join is solved again here. the final
+    // solves start from the basis of the last grid point, as in
+    // search_lambda, so the output does not depend on the number of
+    // blocks
+    int MFSolver::search_lambda_parallel(const float epsilon, float &best_lambda, const bool verbose)
+    {
+        const double powlimit = 6.0;
+        const int npoints = 4 * (int) powlimit + 1;
+        const int nblocks = std::min(mf->solver_options().lambda_threads, npoints);
+        
+        int res;
+        best_lambda = 0;
+        res = solve_for_lambda(0);
+        if (res) return res;
+        const float zero_deviance = get_deviance(0);
+        save_basis();
+        if (verbose) {
+            std::cout << "lam=0 dev=" << zero_deviance;
+            std::cout << " , iterations = " << iterations() << std::endl;
+        }
+        
+        std::vector<float> deviance(npoints);
+        std::vector<double> opt(npoints);
+        std::vector<int> point_iterations(npoints);
+        std::vector<MFLambdaBlock> blocks(nblocks);
+        for (int b = 0; b < nblocks; ++b) {
+            MFLambdaBlock &block = blocks[b];
+            block.solver = this;
+            block.first = b * npoints / nblocks;
+            block.last = (b + 1) * npoints / nblocks;
+            block.epsilon = epsilon;
+            block.zero_deviance = zero_deviance;
+            block.deviance = &deviance;
+            block.opt = &opt;
+            block.iterations = &point_iterations;
+            block.best = -1;
+            block.row_stat = best_row_stat;
+            block.col_stat = best_col_stat;
+            block.res = 0;
+        }
+        
+        std::vector<pthread_t> threads(nblocks);
+        std::vector<char> started(nblocks, 0);
+        for (int b = 1; b < nblocks; ++b) {
+            started[b] = pthread_create(&threads[b], NULL, sweep_main, &blocks[b]) == 0;
+        }
+        blocks[0].res = sweep_lambda(blocks[0]);
+        for (int b = 1; b < nblocks; ++b) {
+            if (started[b]) {
+                pthread_join(threads[b], NULL);
+            } else {
+                sweep_copy(&blocks[b]);
+            }
+        }
+        
+        for (int b = 0; b < nblocks; ++b) {
+            if (blocks[b].res) return blocks[b].res;
+        }
+        
+        // this LP is at the last basis of block 0
+        for (int b = 1; b < nblocks; ++b) {
+            MFLambdaBlock &block = blocks[b];
+            save_basis();
+            const std::vector<int> chain_row_stat = best_row_stat;
+            const std::vector<int> chain_col_stat = best_col_stat;
+            res = solve_for_lambda(pow(2., -powlimit + .5 * block.first));
+            if (res) return res;
+            save_basis();
+            if (best_row_stat == block.first_row_stat && best_col_stat == block.first_col_stat) {
+                best_row_stat = block.last_row_stat;
+                best_col_stat = block.last_col_stat;
+                restore_basis();
+                continue;
+            }
+            
+            if (verbose) {
+                std::cout << "[methylFlow] lambda block " << b << " solved again" << std::endl;
+            }
+            best_row_stat = chain_row_stat;
+            best_col_stat = chain_col_stat;
+            restore_basis();
+            block.best = -1;
+            res = sweep_lambda(block);
+            if (res) return res;
+        }
+        
+        float best_deviance = zero_deviance;
+        for (int b = nblocks - 1; b >= 0; --b) {
+            if (blocks[b].best < 0) continue;
+            best_lambda = pow(2., -powlimit + .5 * blocks[b].best);
+            best_deviance = deviance[blocks[b].best];
+            break;
+        }
+        
+        if (verbose) {
+            for (int k = 0; k < npoints; ++k) {
+                std::cout << "lam=2^" << -powlimit + .5 * k << " dev=" << deviance[k];
+                std::cout << " , opt = " << opt[k];
+                std::cout << " , iterations = " << point_iterations[k] << std::endl;
+            }
+        }
+        
+        if (verbose) {
+            std::cout << "[methylFlow] best lamda found " << best_lambda << " deviance=" << best_deviance << std::endl;
+        }
+        return solve_for_lambda(std::max(0.0, best_lambda-0.00001));
+    }
+    
+    int MFSolver::sweep_lambda(MFLambdaBlock &block)
     {
-        const ListDigraph &mfGraph = mf->get_graph();
+        const double powlimit = 6.0;
         
+        float current_deviance;
+        float current_lambda;
+        int res;
+        
+        for (int k = block.first; k < block.last; ++k) {
+            current_lambda = pow(2., -powlimit + .5 * k);
+            res = solve_for_lambda(current_lambda);
+            if (res) return res;
+            
+            current_deviance = get_deviance(current_lambda);
+            (*block.deviance)[k] = current_deviance;
+            (*block.opt)[k] = lp->primal();
+            (*block.iterations)[k] = iterations();
+            
+            if (current_deviance < 0.00001 || block.zero_deviance / current_deviance >= 1.0 - block.epsilon) {
+                block.best = k;
+            }
+            
+            if (k == block.first || k == block.last - 1) {
+                save_basis();
+                if (k == block.first) {
+                    block.first_row_stat = best_row_stat;
+                    block.first_col_stat = best_col_stat;
+                }
+                if (k == block.last - 1) {
+                    block.last_row_stat = best_row_stat;
+                    block.last_col_stat = best_col_stat;
+                }
+            }
+        }
+        return 0;
+    }
+    
+    void MFSolver::sweep_copy(MFLambdaBlock *block)
+    {
+        // the copy's LP lives in the GLPK environment of this thread
+        MFSolver copy(block->solver->mf);
+        block->res = copy.make_lp(block->solver->length_mult);
+        if (block->res) return;
+        copy.best_row_stat = block->row_stat;
+        copy.best_col_stat = block->col_stat;
+        copy.restore_basis();
+        block->res = copy.sweep_lambda(*block);
+    }
+    
+    void *MFSolver::sweep_main(void *arg)
+    {
+        sweep_copy(static_cast<MFLambdaBlock *>(arg));
+        // GLPK keeps its environment per thread
+        glp_free_env();
+        return NULL;
+    }
+    
+    // lambda only bounds nu of the lambda nodes (their alpha and beta
+    // are free of cost and appear in no other row), so it acts as the
+    // right hand side of the sink rows: the optimal value V is concave
+    // and piecewise linear in lambda, with slope the sum of the sink row
+    // duals. the deviance V - lambda * V' is the intercept of the line
+    // through the current solution, constant between breakpoints and
+    // not decreasing in lambda. so the lambda where it passes the
+    // threshold is a breakpoint, found by intersecting the lines of
+    // solutions on either side of it (Eisner-Severance): a solve at
+    // the intersection either lies on both lines, and is the
+    // breakpoint, or gives a new line in between
+    int MFSolver::search_lambda_path(const float epsilon, float &best_lambda, const bool verbose)
+    {
+        const double max_lambda = pow(2., 6.);
+        const int max_steps = 200;
+        
+        int res;
+        double lo_lambda, lo_deviance, lo_slope;
+        double hi_lambda, hi_deviance, hi_slope;
+        
+        lo_lambda = 0;
+        res = solve_on_path(lo_lambda, lo_deviance, lo_slope, verbose);
+        if (res) return res;
+        save_basis();
+        const double zero_deviance = lo_deviance;
+        
+        hi_lambda = max_lambda;
+        res = solve_on_path(hi_lambda, hi_deviance, hi_slope, verbose);
+        if (res) return res;
+        
+        if (hi_deviance < 0.00001 || zero_deviance / hi_deviance >= 1.0 - epsilon) {
+            lo_lambda = hi_lambda;
+            lo_deviance = hi_deviance;
+            save_basis();
+        } else {
+            for (int step = 0; step < max_steps; ++step) {
+                if (lo_slope - hi_slope <= 1e-9 * (1. + fabs(lo_slope))) break;
+                const float lambda = (float) ((hi_deviance - lo_deviance) / (lo_slope - hi_slope));
+                if (lambda <= lo_lambda || lambda >= hi_lambda) break;
+                
+                double deviance, slope;
+                res = solve_on_path(lambda, deviance, slope, verbose);
+                if (res) return res;
+                
+                // the solution lies on the line of lo: lambda is the breakpoint
+                const double value = deviance + lambda * slope;
+                const double lo_value = lo_deviance + lambda * lo_slope;
+                if (lo_value - value <= 1e-7 * (1. + fabs(value))) {
+                    lo_lambda = lambda;
+                    break;
+                }
+                
+                if (deviance < 0.00001 || zero_deviance / deviance >= 1.0 - epsilon) {
+                    lo_lambda = lambda;
+                    lo_deviance = deviance;
+                    lo_slope = slope;
+                    save_basis();
+                } else {
+                    hi_lambda = lambda;
+                    hi_deviance = deviance;
+                    hi_slope = slope;
+                }
+            }
+        }
+        
+        // the basis of lo is optimal up to the breakpoint
+        best_lambda = (float) lo_lambda;
+        
+        if (verbose) {
+            std::cout << "[methylFlow] best lamda found " << best_lambda << " deviance=" << lo_deviance << std::endl;
+        }
+        restore_basis();
+        return solve_for_lambda(std::max(0.0, best_lambda-0.00001));
+    }
+    
+    int MFSolver::solve_on_path(const float lambda, double &deviance, double &slope, const bool verbose)
+    {
+        int res = solve_for_lambda(lambda);
+        if (res) return res;
+        
+        slope = 0.;
+        const int sink = graph.sink();
+        for (int i = graph.in_begin(sink); i < graph.in_end(sink); ++i) {
+            slope += lp->dual(rows[graph.in_arc(i)]);
+        }
+        deviance = lp->primal() - lambda * slope;
+        
+        if (verbose) {
+            std::cout << "lam=" << lambda << " dev=" << deviance;
+            std::cout << " , opt = " <<  lp->primal();
+            std::cout << " , iterations = " << iterations() << std::endl;
+        }
+        return 0;
+    }
+    
+    void MFSolver::save_basis()
+    {
+        glp_prob *prob = lp->lpx();
+        const int nrows = glp_get_num_rows(prob);
+        const int ncols = glp_get_num_cols(prob);
+        best_row_stat.resize(nrows + 1);
+        best_col_stat.resize(ncols + 1);
+        for (int i = 1; i <= nrows; ++i) best_row_stat[i] = glp_get_row_stat(prob, i);
+        for (int j = 1; j <= ncols; ++j) best_col_stat[j] = glp_get_col_stat(prob, j);
+    }
+    
+    void MFSolver::restore_basis()
+    {
+        glp_prob *prob = lp->lpx();
+        const int nrows = glp_get_num_rows(prob);
+        const int ncols = glp_get_num_cols(prob);
+        if ((int) best_row_stat.size() != nrows + 1 || (int) best_col_stat.size() != ncols + 1) return;
+        for (int i = 1; i <= nrows; ++i) glp_set_row_stat(prob, i, best_row_stat[i]);
+        for (int j = 1; j <= ncols; ++j) glp_set_col_stat(prob, j, best_col_stat[j]);
+    }
+    
+    int MFSolver::iterations() const
+    {
+        return last_iterations;
+    }
+    
+    int MFSolver::iteration_count() const
+    {
+        // GLPK counts the simplex iterations of all solves of the LP
+        return lpx_get_int_parm(lp->lpx(), LPX_K_ITCNT);
+    }
+    
+    // the flows are the duals of the arc rows. the dual minimizes, over
+    // source-sink flows f, the sum over real nodes v of
+    //   |coverage(v) - sum over out arcs a of v of L(a) f(a)|
+    // with L(a) the scaled length, or lambda for arcs into the sink. a
+    // node's term is a cost on the flow through it only when all its out
+    // arcs share one length. a node with children at different starts
+    // weighs its out flows differently, which makes this a generalized
+    // flow: no min cost flow solver can take the general component
+    int MFSolver::make_lp(const float length_mult)
+    {
+        delete lp;
         lp = new Lp();
+        this->length_mult = length_mult;
         
         // scale the lengths
-        for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
+        for (int arc = 0; arc < graph.arc_count(); ++arc) {
             // divid int by int is not a float.
-            scaled_length[arc] = float(mf->effective_length(arc)) / length_mult;
+            scaled_length[arc] = float(graph.effective_length[arc]) / length_mult;
         }
         
         Lp::Expr obj;
         
 #ifndef NDEBUG
-        std::cout << "making LP on " << countNodes(mf->mfGraph) << " nodes" << std::endl;
+        std::cout << "making LP on " << graph.node_count() << " nodes" << std::endl;
 #endif
         
-        for (ListDigraph::NodeIt v(mfGraph); v != INVALID; ++v) {
+        for (int v = 0; v < graph.node_count(); ++v) {
 #ifndef NDEBUG
-            std::cout << "Processing node " << mf->nodeName_map[v] << std::endl;
+            std::cout << "Processing node " << mf->nodeName_map[graph.node[v]] << std::endl;
 #endif
             
-            if (mf->fake[v]) continue;
+            if (graph.fake[v]) continue;
             
             
             
@@ -127,7 +485,7 @@ namespace methylFlow {
 #endif
             
             // add node's term in objective
-            obj += mf->normalized_coverage(v) * (beta[v] - alpha[v]);
+            obj += graph.normalized_coverage[v] * (beta[v] - alpha[v]);
             
 #ifndef NDEBUG
             std::cout << "obj added" << std::endl;
@@ -135,8 +493,10 @@ namespace methylFlow {
         }
         
         // bound nu variable for source targets
-        for (ListDigraph::OutArcIt arc(mfGraph, mf->get_source()); arc != INVALID; ++arc) {
-            ListDigraph::Node v = mfGraph.target(arc);
+        const int source = graph.source();
+        for (int i = graph.out_begin(source); i < graph.out_end(source); ++i) {
+            const int arc = graph.out_arc(i);
+            const int v = graph.arc_target[arc];
             rows[arc] = lp->addRow(nu[v] <= 0);
         }
 #ifndef NDEBUG
@@ -144,8 +504,10 @@ namespace methylFlow {
 #endif
         
         // add sink constraints
-        for (ListDigraph::InArcIt arc(mfGraph, mf->get_sink()); arc != INVALID; ++arc) {
-            ListDigraph::Node v = mfGraph.source(arc);
+        const int sink = graph.sink();
+        for (int i = graph.in_begin(sink); i < graph.in_end(sink); ++i) {
+            const int arc = graph.in_arc(i);
+            const int v = graph.arc_source[arc];
             rows[arc] = lp->addRow(scaled_length[arc] * beta[v] -
                                    scaled_length[arc] * alpha[v] - nu[v] <= 0);
         }
@@ -154,12 +516,15 @@ namespace methylFlow {
 #endif
        
         // add remaining constraints (if not childless)
-        for (IterableBoolMap<ListDigraph, ListDigraph::Node>::FalseIt v(mf->fake); v != INVALID; ++v) {
-            if (mf->childless[v]) continue;
+        const std::vector<int> &real_nodes = graph.real_nodes();
+        for (std::size_t j = 0; j < real_nodes.size(); ++j) {
+            const int v = real_nodes[j];
+            if (graph.childless[v]) continue;
             
-            for (ListDigraph::OutArcIt arc(mfGraph, v); arc != INVALID; ++arc) {
-                ListDigraph::Node u = mfGraph.target(arc);
-                if (u == INVALID) {
+            for (int i = graph.out_begin(v); i < graph.out_end(v); ++i) {
+                const int arc = graph.out_arc(i);
+                const int u = graph.arc_target[arc];
+                if (u < 0) {
                     std::cout << "error getting target from arc" << std::endl;
                     return -1;
                 }
@@ -179,8 +544,9 @@ namespace methylFlow {
     float MFSolver::get_deviance(const float lambda)
     {
         float obj = lp->primal();
-        for (ListDigraph::InArcIt arc(mf->mfGraph, mf->sink); arc != INVALID; ++arc) {
-            obj -= lambda * lp->dual(rows[arc]);
+        const int sink = graph.sink();
+        for (int i = graph.in_begin(sink); i < graph.in_end(sink); ++i) {
+            obj -= lambda * lp->dual(rows[graph.in_arc(i)]);
         }
         return obj;
     }
@@ -188,34 +554,27 @@ namespace methylFlow {
     int MFSolver::solve_for_lambda(const float lambda)
     {
         // modify lambda constraints
-        for (ListDigraph::InArcIt arc(mf->mfGraph, mf->sink); arc != INVALID; ++arc) {
-            ListDigraph::Node v = mf->mfGraph.source(arc);
+        const int sink = graph.sink();
+        for (int i = graph.in_begin(sink); i < graph.in_end(sink); ++i) {
+            const int arc = graph.in_arc(i);
+            const int v = graph.arc_source[arc];
             Lp::Row row = rows[arc];
 //            lp->row(row, -lambda * beta[v] - (-lambda * alpha[v]) - nu[v] <= 0);
             lp->row(row, lambda * beta[v] - (lambda * alpha[v]) - nu[v] <= 0);
         }
 #ifndef NDEBUG
         std::cout << "lambda constraints updated" << std::endl;
-        std::cout << "running solver on " << countNodes(mf->get_graph()) << " nodes" << std::endl;
+        std::cout << "running solver on " << graph.node_count() << " nodes" << std::endl;
 #endif
         
         
+        const int iterations_before = iteration_count();
         lp->solve();
+        last_iterations = iteration_count() - iterations_before;
 #ifndef NDEBUG
         std::cout << "obj = " << lp->primal() << std::endl;
         std::cout << "get last deviance = " << get_deviance(lambda) << std::endl;
 #endif
-        for (ListDigraph::NodeIt v(mf->get_graph()); v != INVALID; ++v) {
-            
-            if (mf->fake[v]) continue;
- //           std::cout << "alpha " << mf->nodeName_map[v] << " = " << lp->primal(alpha[v]) << std::endl;
- //           std::cout << "beta " << mf->nodeName_map[v] << " = " << lp->primal(beta[v]) << std::endl;
- //           std::cout << "nu " << mf->nodeName_map[v] << " = " << lp->primal(nu[v]) << std::endl;
-
-        }
-
-
-        
 #ifndef NDEBUG
         std::cout << "obj = " << lp->primal() << std::endl;
         std::cout << "Called solver" << std::endl;
@@ -232,15 +591,17 @@ namespace methylFlow {
     {
         // extract flows
         // TODO: check Lp is there and solved
-        for (ListDigraph::ArcIt arc(mf->get_graph()); arc != INVALID; ++arc) {
+        MFFrozenGraph &frozen = mf->frozen;
+        for (int arc = 0; arc < frozen.arc_count(); ++arc) {
 #ifndef NDEBUG
             std::cout << "Extracting flow of arc: " << std::endl;
-            std::cout << mf->nodeName_map[mf->get_graph().source(arc)];
+            std::cout << mf->nodeName_map[frozen.node[frozen.arc_source[arc]]];
             std::cout << " -> ";
-            std::cout << mf->nodeName_map[mf->get_graph().target(arc)] << std::endl;
+            std::cout << mf->nodeName_map[frozen.node[frozen.arc_target[arc]]] << std::endl;
 #endif
             Lp::Row row = rows[arc];
-            mf->flow_map[arc] = lp->dual(row);
+            frozen.flow[arc] = lp->dual(row);
+            mf->flow_map[frozen.arc[arc]] = frozen.flow[arc];
         }
         return 0;
     }
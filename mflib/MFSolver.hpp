@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "MFGraph.hpp"
 
 using namespace lemon;
@@ -7,6 +9,8 @@ using namespace lemon;
 
 namespace methylFlow {
 
+  struct MFLambdaBlock;
+
   class MFSolver {
   public:
     MFSolver(MFGraph *mfobj);
@@ -18,18 +22,43 @@ namespace methylFlow {
     // extract flows from LP solution
     int extract_flows();
 
+    // simplex iterations of the last solve
+    int iterations() const;
+
   protected:
     MFGraph *mf;
 
   private:
     Lp *lp;
-    ListDigraph::NodeMap<Lp::Col> alpha;
-    ListDigraph::NodeMap<Lp::Col> beta;
-    ListDigraph::NodeMap<Lp::Col> nu;
+    float length_mult;
+    // the graph solved, mf->frozen. columns by node index, rows and
+    // lengths by arc index
+    const MFFrozenGraph &graph;
+    std::vector<Lp::Col> alpha;
+    std::vector<Lp::Col> beta;
+    std::vector<Lp::Col> nu;
 
     
-    ListDigraph::ArcMap<Lp::Row> rows;
-    ListDigraph::ArcMap<float> scaled_length;
+    std::vector<Lp::Row> rows;
+    std::vector<float> scaled_length;
+
+    // each solve starts from the basis the LP was left in, so the
+    // lambda search warm starts from the optimum of the previous
+    // lambda. search_lambda's final solves start from the basis of the
+    // last grid point, as they always have: the flows of a degenerate
+    // component depend on the basis. search_lambda_parallel follows the
+    // same chain of bases to start them from the same one,
+    // search_lambda_path starts them from the basis of the best lambda
+    int last_iterations;
+    std::vector<int> best_row_stat;
+    std::vector<int> best_col_stat;
+
+    // simplex iterations of all solves of the LP so far
+    int iteration_count() const;
+
+    // keep/reload the current basis as that of the best lambda
+    void save_basis();
+    void restore_basis();
 
     // make the LP object
     int make_lp(const float length_mult);
@@ -41,6 +70,26 @@ namespace methylFlow {
     // find the best lambda
     int search_lambda(const float epislon, float &best_lambda, const bool verbose);
 
+    // search_lambda with the grid split in blocks, solved by threads
+    // on copies of the LP
+    int search_lambda_parallel(const float epsilon, float &best_lambda, const bool verbose);
+
+    // solve the grid points of a block, keeping the last one passing
+    // the threshold and the bases at the first and last of them
+    int sweep_lambda(MFLambdaBlock &block);
+
+    // sweep a block on a copy of the LP made in the calling thread
+    static void sweep_copy(MFLambdaBlock *block);
+    static void *sweep_main(void *arg);
+
+    // find the best lambda by following the solutions along lambda
+    // (LAMBDA_PATH)
+    int search_lambda_path(const float epsilon, float &best_lambda, const bool verbose);
+
+    // solve for lambda on the path, with the deviance and the slope of
+    // the optimal value in lambda
+    int solve_on_path(const float lambda, double &deviance, double &slope, const bool verbose);
+
     // get deviance for current solution
     float get_deviance(const float lambda);
   };
@@ -0,0 +1,35 @@
+#ifndef MFSOLVEROPTIONS_H
+#define MFSOLVEROPTIONS_H
+
+namespace methylFlow {
+
+    // how MFSolver searches for lambda when none is given (lambda < 0)
+    enum MFLambdaSearch {
+        // solve for lambda = 0 and 2^k for k = -6, -5.5, ..., 6, keep
+        // the largest that passes the epsilon threshold
+        LAMBDA_GRID,
+        // follow the optimal value along lambda in [0, 2^6] to the
+        // exact lambda where the deviance passes the threshold
+        LAMBDA_PATH
+    };
+
+    // settings of MFSolver beyond the arguments of MFGraph::run, set on
+    // MFGraph and the runners with set_solver_options
+    struct MFSolverOptions {
+        MFLambdaSearch lambda_search;
+        // threads splitting the LAMBDA_GRID search of components with at
+        // least lambda_threads_min_nodes nodes, each on its own copy of
+        // the LP
+        int lambda_threads;
+        int lambda_threads_min_nodes;
+        // solve components without overlapping reads in closed form
+        // (MFGraph::solve_closed_form) rather than with the solver
+        bool closed_form;
+
+        MFSolverOptions() : lambda_search(LAMBDA_GRID), lambda_threads(1),
+                            lambda_threads_min_nodes(1000), closed_form(true) {}
+    };
+
+} // namespace methylFlow
+
+#endif // MFSOLVEROPTIONS_H
@@ -0,0 +1,75 @@
+#include <vector>
+#include <cstddef>
+
+#ifndef MFSPSCQUEUE_H
+#define MFSPSCQUEUE_H
+
+namespace methylFlow {
+
+    // bounded lock-free queue for exactly one producer and one consumer thread
+    // push and pop never block, callers decide how to wait on a full/empty queue
+    template <typename T>
+    class MFSpscQueue {
+    public:
+        // capacity is rounded up to a power of two
+        explicit MFSpscQueue(const std::size_t capacity);
+
+        // producer side, returns false if the queue is full
+        bool push(const T &item);
+
+        // consumer side, returns false if the queue is empty
+        bool pop(T &item);
+
+        std::size_t capacity() const;
+
+    private:
+        // keep producer and consumer counters on separate cache lines
+        static const std::size_t CACHE_LINE = 64;
+
+        std::vector<T> items;
+        std::size_t mask;
+        char pad0[CACHE_LINE];
+        std::size_t head; // next slot to pop, written by consumer
+        char pad1[CACHE_LINE];
+        std::size_t tail; // next slot to push, written by producer
+        char pad2[CACHE_LINE];
+    };
+
+    template <typename T>
+    MFSpscQueue<T>::MFSpscQueue(const std::size_t capacity) : items(), mask(0), head(0), tail(0)
+    {
+        std::size_t size = 1;
+        while (size < capacity) size <<= 1;
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    template <typename T>
+    bool MFSpscQueue<T>::push(const T &item)
+    {
+        const std::size_t t = tail;
+        if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) > mask) return false;
+        items[t & mask] = item;
+        __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    template <typename T>
+    bool MFSpscQueue<T>::pop(T &item)
+    {
+        const std::size_t h = head;
+        if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) return false;
+        item = items[h & mask];
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    template <typename T>
+    std::size_t MFSpscQueue<T>::capacity() const
+    {
+        return mask + 1;
+    }
+
+} // namespace methylFlow
+
+#endif // MFSPSCQUEUE_H
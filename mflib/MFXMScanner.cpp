@@ -0,0 +1,222 @@
+#include "MFXMScanner.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MF_XM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace methylFlow {
+
+    MFXMContextCounts::MFXMContextCounts() : chg_methylated(0), chg_unmethylated(0),
+    chh_methylated(0), chh_unmethylated(0)
+    {
+    }
+
+    typedef void (*ScanFn)(const char *, const char *, MFOffsetVector &,
+                           MFCallVector &, MFXMContextCounts *);
+
+    static void scan_scalar(const char *begin, const char *end,
+                            MFOffsetVector &offsets, MFCallVector &methyl,
+                            MFXMContextCounts *counts, const char *p)
+    {
+        // c | 0x20 maps only 'Z' and 'z' to 'z', same for x and h
+        if (!counts) {
+            for (; p < end; ++p) {
+                if ((*p | 0x20) == 'z') {
+                    offsets.push_back(p - begin);
+                    methyl.push_back(*p == 'Z');
+                }
+            }
+            return;
+        }
+
+        for (; p < end; ++p) {
+            switch (*p) {
+                case 'Z': offsets.push_back(p - begin); methyl.push_back(true); break;
+                case 'z': offsets.push_back(p - begin); methyl.push_back(false); break;
+                case 'X': counts->chg_methylated++; break;
+                case 'x': counts->chg_unmethylated++; break;
+                case 'H': counts->chh_methylated++; break;
+                case 'h': counts->chh_unmethylated++; break;
+                default: break;
+            }
+        }
+    }
+
+    static void scan_xm_scalar(const char *begin, const char *end,
+                               MFOffsetVector &offsets, MFCallVector &methyl,
+                               MFXMContextCounts *counts)
+    {
+        scan_scalar(begin, end, offsets, methyl, counts, begin);
+    }
+
+#ifdef MF_XM_X86
+    // emit CpGs found in a chunk starting at offset base
+    // cpg has a bit set for z/Z, meth for Z only
+    static inline void emit_cpgs(unsigned int cpg, const unsigned int meth, const int base,
+                                 MFOffsetVector &offsets, MFCallVector &methyl)
+    {
+        while (cpg) {
+            int bit = __builtin_ctz(cpg);
+            offsets.push_back(base + bit);
+            methyl.push_back((meth >> bit) & 1);
+            cpg &= cpg - 1;
+        }
+    }
+
+    // context calls are counted in per-byte lanes (cmpeq gives -1 per
+    // match) and summed with sad before the 8-bit lanes can overflow
+    static const int LANE_FLUSH = 255;
+
+    __attribute__((target("sse2")))
+    static inline long sum_lanes_sse2(const __m128i acc)
+    {
+        __m128i sad = _mm_sad_epu8(acc, _mm_setzero_si128());
+        return _mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+    }
+
+    __attribute__((target("sse2")))
+    static void scan_xm_sse2(const char *begin, const char *end,
+                             MFOffsetVector &offsets, MFCallVector &methyl,
+                             MFXMContextCounts *counts)
+    {
+        const __m128i lower = _mm_set1_epi8(0x20);
+        const __m128i z = _mm_set1_epi8('z'), Z = _mm_set1_epi8('Z');
+        const __m128i x = _mm_set1_epi8('x'), X = _mm_set1_epi8('X');
+        const __m128i h = _mm_set1_epi8('h'), H = _mm_set1_epi8('H');
+        __m128i chg = _mm_setzero_si128(), chg_meth = _mm_setzero_si128();
+        __m128i chh = _mm_setzero_si128(), chh_meth = _mm_setzero_si128();
+        int nchunks = 0;
+
+        const char *p = begin;
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i folded = _mm_or_si128(v, lower);
+            unsigned int cpg = _mm_movemask_epi8(_mm_cmpeq_epi8(folded, z));
+            if (cpg) {
+                unsigned int meth = _mm_movemask_epi8(_mm_cmpeq_epi8(v, Z));
+                emit_cpgs(cpg, meth, p - begin, offsets, methyl);
+            }
+            if (!counts) continue;
+
+            chg = _mm_sub_epi8(chg, _mm_cmpeq_epi8(folded, x));
+            chg_meth = _mm_sub_epi8(chg_meth, _mm_cmpeq_epi8(v, X));
+            chh = _mm_sub_epi8(chh, _mm_cmpeq_epi8(folded, h));
+            chh_meth = _mm_sub_epi8(chh_meth, _mm_cmpeq_epi8(v, H));
+            if (++nchunks == LANE_FLUSH || end - p < 32) {
+                long nchg_meth = sum_lanes_sse2(chg_meth), nchh_meth = sum_lanes_sse2(chh_meth);
+                counts->chg_methylated += nchg_meth;
+                counts->chg_unmethylated += sum_lanes_sse2(chg) - nchg_meth;
+                counts->chh_methylated += nchh_meth;
+                counts->chh_unmethylated += sum_lanes_sse2(chh) - nchh_meth;
+                chg = chg_meth = chh = chh_meth = _mm_setzero_si128();
+                nchunks = 0;
+            }
+        }
+        scan_scalar(begin, end, offsets, methyl, counts, p);
+    }
+
+    __attribute__((target("avx2")))
+    static inline long sum_lanes_avx2(const __m256i acc)
+    {
+        __m256i sad = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+        return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    }
+
+    __attribute__((target("avx2")))
+    static void scan_xm_avx2(const char *begin, const char *end,
+                             MFOffsetVector &offsets, MFCallVector &methyl,
+                             MFXMContextCounts *counts)
+    {
+        const __m256i lower = _mm256_set1_epi8(0x20);
+        const __m256i z = _mm256_set1_epi8('z'), Z = _mm256_set1_epi8('Z');
+        const __m256i x = _mm256_set1_epi8('x'), X = _mm256_set1_epi8('X');
+        const __m256i h = _mm256_set1_epi8('h'), H = _mm256_set1_epi8('H');
+        __m256i chg = _mm256_setzero_si256(), chg_meth = _mm256_setzero_si256();
+        __m256i chh = _mm256_setzero_si256(), chh_meth = _mm256_setzero_si256();
+        int nchunks = 0;
+
+        const char *p = begin;
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i folded = _mm256_or_si256(v, lower);
+            unsigned int cpg = _mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, z));
+            if (cpg) {
+                unsigned int meth = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, Z));
+                emit_cpgs(cpg, meth, p - begin, offsets, methyl);
+            }
+            if (!counts) continue;
+
+            chg = _mm256_sub_epi8(chg, _mm256_cmpeq_epi8(folded, x));
+            chg_meth = _mm256_sub_epi8(chg_meth, _mm256_cmpeq_epi8(v, X));
+            chh = _mm256_sub_epi8(chh, _mm256_cmpeq_epi8(folded, h));
+            chh_meth = _mm256_sub_epi8(chh_meth, _mm256_cmpeq_epi8(v, H));
+            if (++nchunks == LANE_FLUSH || end - p < 64) {
+                long nchg_meth = sum_lanes_avx2(chg_meth), nchh_meth = sum_lanes_avx2(chh_meth);
+                counts->chg_methylated += nchg_meth;
+                counts->chg_unmethylated += sum_lanes_avx2(chg) - nchg_meth;
+                counts->chh_methylated += nchh_meth;
+                counts->chh_unmethylated += sum_lanes_avx2(chh) - nchh_meth;
+                chg = chg_meth = chh = chh_meth = _mm256_setzero_si256();
+                nchunks = 0;
+            }
+        }
+        scan_scalar(begin, end, offsets, methyl, counts, p);
+    }
+#endif // MF_XM_X86
+
+    static bool supported(const XMScanImpl impl)
+    {
+#ifdef MF_XM_X86
+        __builtin_cpu_init();
+        if (impl == XM_SCAN_AVX2) return __builtin_cpu_supports("avx2");
+        if (impl == XM_SCAN_SSE2) return __builtin_cpu_supports("sse2");
+#endif
+        return impl == XM_SCAN_SCALAR;
+    }
+
+    static ScanFn scan_function(const XMScanImpl impl)
+    {
+        if (!supported(impl)) return scan_xm_scalar;
+#ifdef MF_XM_X86
+        if (impl == XM_SCAN_AVX2) return scan_xm_avx2;
+        if (impl == XM_SCAN_SSE2) return scan_xm_sse2;
+#endif
+        return scan_xm_scalar;
+    }
+
+    XMScanImpl xm_scan_best()
+    {
+        if (supported(XM_SCAN_AVX2)) return XM_SCAN_AVX2;
+        if (supported(XM_SCAN_SSE2)) return XM_SCAN_SSE2;
+        return XM_SCAN_SCALAR;
+    }
+
+    const char *xm_scan_name(const XMScanImpl impl)
+    {
+        switch (impl) {
+            case XM_SCAN_AVX2: return "avx2";
+            case XM_SCAN_SSE2: return "sse2";
+            default: return "scalar";
+        }
+    }
+
+    // chosen once when the library is loaded
+    static const ScanFn best_scan = scan_function(xm_scan_best());
+
+    void scan_xm_tag(const char *begin, const char *end,
+                     MFOffsetVector &offsets, MFCallVector &methyl,
+                     MFXMContextCounts *counts)
+    {
+        best_scan(begin, end, offsets, methyl, counts);
+    }
+
+    void scan_xm_tag(const char *begin, const char *end,
+                     MFOffsetVector &offsets, MFCallVector &methyl,
+                     MFXMContextCounts *counts, const XMScanImpl impl)
+    {
+        scan_function(impl)(begin, end, offsets, methyl, counts);
+    }
+
+} // namespace methylFlow
@@ -0,0 +1,43 @@
+#include <vector>
+
+#include "MFReadArena.hpp"
+
+#ifndef MFXMSCANNER_H
+#define MFXMSCANNER_H
+
+namespace methylFlow {
+
+    // methylation calls outside CpG context seen in XM tags
+    // (Bismark: x/X CHG, h/H CHH, upper case is methylated)
+    struct MFXMContextCounts {
+        MFXMContextCounts();
+
+        long chg_methylated;
+        long chg_unmethylated;
+        long chh_methylated;
+        long chh_unmethylated;
+    };
+
+    // XM scanner implementations, SIMD ones are only available on x86
+    enum XMScanImpl { XM_SCAN_SCALAR, XM_SCAN_SSE2, XM_SCAN_AVX2 };
+
+    // fastest implementation supported by the running cpu
+    XMScanImpl xm_scan_best();
+    const char *xm_scan_name(const XMScanImpl impl);
+
+    // single pass over an XM tag value [begin, end) appending the offset
+    // and call (Z methylated, z unmethylated) of each CpG to offsets and
+    // methyl. CHG/CHH calls are added to counts if given
+    void scan_xm_tag(const char *begin, const char *end,
+                     MFOffsetVector &offsets, MFCallVector &methyl,
+                     MFXMContextCounts *counts = 0);
+
+    // same as above with a given implementation, unsupported ones
+    // fall back to the scalar scanner
+    void scan_xm_tag(const char *begin, const char *end,
+                     MFOffsetVector &offsets, MFCallVector &methyl,
+                     MFXMContextCounts *counts, const XMScanImpl impl);
+
+} // namespace methylFlow
+
+#endif // MFXMSCANNER_H
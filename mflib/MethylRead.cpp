@@ -2,91 +2,150 @@
 #include <iostream>
 #include <sstream>
 #include <cassert>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 
 #include "MethylRead.hpp"
 
 namespace methylFlow {
-  MethylRead::MethylRead(int pos, int len) : rPos(pos), rLen(len), cpgOffset(), methyl(), coverage(0)
+  MethylRead::MethylRead(int pos, int len) : cpgOffset(), methyl(), rPos(pos), rLen(len), coverage(0),
+  bits(), nwords(0), packed(0)
   {
   }
 
-  MethylRead::MethylRead(const MethylRead &read) : rPos(read.start()), rLen(read.length()), coverage(read.coverage)
+  MethylRead::MethylRead(const MethylRead &read) : cpgOffset(read.cpgOffset), methyl(read.methyl),
+  rPos(read.start()), rLen(read.length()), coverage(read.coverage),
+  bits(read.bits), nwords(read.nwords), packed(read.packed)
   {
-    this->cpgOffset = std::vector<int>(read.cpgOffset);
-    this->methyl = std::vector<bool>(read.methyl);
   }
 
   MethylRead::~MethylRead()
   {
   }
 
-  int MethylRead::parseMethyl(std::string methString)
+  void *MethylRead::operator new(std::size_t size)
   {
-    std::size_t found;
-    std::size_t curStringOffset = 0; 
-    int curPos = 0;
-    bool curMeth = false;
-      if (methString.length() == 0) {
-          std::cout << "Error parsing methylation string, There is no read" << std::endl;
-          return -1;
+    return MFReadArena::allocate(size);
+  }
 
-      }
-      char  lastChar = methString.at( methString.length() - 1 );
-      if (lastChar != ',') {
-          methString.append(1, ',');
-      }
-    while (curStringOffset < methString.length()) {
-      found = methString.find(":", curStringOffset);
+  void MethylRead::operator delete(void *p)
+  {
+    MFReadArena::release(p);
+  }
 
-      if (found == std::string::npos) {
-          std::cout << "Error parsing methylation string, : is not found" << std::endl;
-	return -1;
-      }
+  // parse an offset the way atoi does, stops at the first non-digit
+  static int parse_offset(const char *begin, const char *end)
+  {
+    while (begin < end && isspace(static_cast<unsigned char>(*begin))) ++begin;
+
+    bool negative = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+      negative = (*begin == '-');
+      ++begin;
+    }
+
+    int value = 0;
+    for (; begin < end && *begin >= '0' && *begin <= '9'; ++begin) {
+      value = value * 10 + (*begin - '0');
+    }
+    return negative ? -value : value;
+  }
+
+  int MethylRead::parseMethyl(const std::string &methString)
+  {
+    return parseMethyl(methString.data(), methString.data() + methString.size());
+  }
 
-      curPos = atoi(methString.substr(curStringOffset, found - curStringOffset).c_str());
+  int MethylRead::parseMethyl(const char *begin, const char *end)
+  {
+    const char *cur = begin;
+    const char *found;
 
-      curStringOffset = found + 1;
-      found = methString.find(",", curStringOffset);
+    if (begin == end) {
+      std::cout << "Error parsing methylation string, There is no read" << std::endl;
+      return -1;
+    }
 
-      if (found == std::string::npos) {
-	std::cout << "Error parsing methylation string, , is not found" << std::endl;
-	return -1;
+    offsets_changed();
+
+    // one entry per ':', grow the vectors once
+    std::size_t n = std::count(begin, end, ':');
+    cpgOffset.reserve(cpgOffset.size() + n);
+    methyl.reserve(methyl.size() + n);
+
+    while (cur < end) {
+      found = static_cast<const char *>(memchr(cur, ':', end - cur));
+      if (!found) {
+        std::cout << "Error parsing methylation string, : is not found" << std::endl;
+        return -1;
       }
-      curMeth = (methString.substr(curStringOffset, found - curStringOffset) == "M"); 
+      int curPos = parse_offset(cur, found);
+
+      // a missing trailing comma ends the last entry
+      cur = found + 1;
+      found = static_cast<const char *>(memchr(cur, ',', end - cur));
+      if (!found) found = end;
+
+      bool curMeth = (found - cur == 1 && *cur == 'M');
       cpgOffset.push_back(curPos);
       methyl.push_back(curMeth);
-      curStringOffset = found + 1;
+      cur = found + 1;
     }
     return 0;
   }
     
     
   int MethylRead::parseXMtag(std::string XM){
-      std::size_t foundU, foundM, found;
       std::size_t curStringOffset = XM.find("XM:Z:", 0) + 5;
-      
-      int curPos = 0;
-      bool curMeth = false;
-      
-      while (curStringOffset < XM.length()) {
-          foundM = XM.find("Z", curStringOffset);
-          foundU = XM.find("z", curStringOffset);
-          
-          found = std::min(foundM, foundU);
-          
-          if (found == std::string::npos) {
-              break;
-          }
-          curPos = found - 5;
-          curMeth = (XM[found] == 'Z');
-          cpgOffset.push_back(curPos);
-          methyl.push_back(curMeth);
-          curStringOffset = found + 1;
+      if (curStringOffset >= XM.length()) {
+          return 0;
+      }
+
+      // offsets are relative to the value of a tag at the start of XM
+      std::size_t first = cpgOffset.size();
+      offsets_changed();
+      int shift = (int) curStringOffset - 5;
+      parseXMtag(XM.data() + curStringOffset, XM.data() + XM.length());
+      for (std::size_t i = first; shift != 0 && i < cpgOffset.size(); ++i) {
+          cpgOffset[i] += shift;
       }
       return 0;
       
   }
 
+  int MethylRead::parseXMtag(const char *begin, const char *end, MFXMContextCounts *counts)
+  {
+      offsets_changed();
+      scan_xm_tag(begin, end, cpgOffset, methyl, counts);
+      return 0;
+  }
+
+
+  static inline uint64_t mix_fingerprint(uint64_t h, const uint64_t v)
+  {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+  }
+
+  uint64_t MethylRead::fingerprint() const
+  {
+    uint64_t h = mix_fingerprint((uint64_t) (unsigned int) rPos, (uint64_t) (unsigned int) rLen);
+    for (std::size_t i = 0; i < cpgOffset.size(); ++i) {
+      h = mix_fingerprint(h, ((uint64_t) (unsigned int) cpgOffset[i] << 1) | methyl[i]);
+    }
+    // final avalanche so nearby positions spread over the table
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  bool MethylRead::isDuplicate(const MethylRead *other) const
+  {
+    return rPos == other->rPos && rLen == other->rLen &&
+      cpgOffset == other->cpgOffset && methyl == other->methyl;
+  }
 
   const std::string MethylRead::getMethString() const
   {
@@ -171,15 +230,70 @@ namespace methylFlow {
         std::cout << std::endl;
     }
     
-  bool MethylRead::isMethConsistent(MethylRead *other)
+  bool MethylRead::pack()
   {
-    // always assume comparing left read to right read
-    if (this->start() > other->start())
-      return false;
+    if (packed != 0) return packed > 0;
 
-    if (this->ncpgs() == 0 || other->ncpgs() == 0)
+    // no cpgs, empty masks
+    if (cpgOffset.empty()) {
+      bits.clear();
+      nwords = 0;
+      packed = 1;
       return true;
+    }
+
+    packed = -1;
+    int last = -1;
+    for (std::size_t i = 0; i < cpgOffset.size(); ++i) {
+      if (cpgOffset[i] <= last) return false;
+      last = cpgOffset[i];
+    }
+
+    nwords = (std::size_t) last / 64 + 1;
+    bits.assign(2 * nwords, 0);
+    uint64_t *cpg = &bits[0];
+    uint64_t *meth = cpg + nwords;
+    for (std::size_t i = 0; i < cpgOffset.size(); ++i) {
+      const uint64_t bit = (uint64_t) 1 << (cpgOffset[i] % 64);
+      cpg[cpgOffset[i] / 64] |= bit;
+      if (methyl[i]) meth[cpgOffset[i] / 64] |= bit;
+    }
+    packed = 1;
+    return true;
+  }
+
+  // 64 bits of words starting at bit 64 * w + shift
+  static inline uint64_t word_at(const uint64_t *words, const std::size_t n,
+                                 const std::size_t w, const unsigned int shift)
+  {
+    uint64_t out = words[w] >> shift;
+    if (shift != 0 && w + 1 < n) out |= words[w + 1] << (64 - shift);
+    return out;
+  }
 
+  // cpgs of other line up with those of this shifted right by offset,
+  // calls must agree wherever both have a cpg
+  bool MethylRead::isMethConsistentPacked(const MethylRead *other) const
+  {
+    if (nwords == 0 || other->nwords == 0) return true;
+
+    const std::size_t offset = other->start() - this->start();
+    const unsigned int shift = offset % 64;
+    const uint64_t *cpg = &bits[0];
+    const uint64_t *meth = cpg + nwords;
+    const uint64_t *other_cpg = &other->bits[0];
+    const uint64_t *other_meth = other_cpg + other->nwords;
+
+    for (std::size_t k = 0, w = offset / 64; k < other->nwords && w < nwords; ++k, ++w) {
+      const uint64_t common = word_at(cpg, nwords, w, shift) & other_cpg[k];
+      const uint64_t differ = word_at(meth, nwords, w, shift) ^ other_meth[k];
+      if (common & differ) return false;
+    }
+    return true;
+  }
+
+  bool MethylRead::isMethConsistentOffsets(const MethylRead *other) const
+  {
     int offset = other->start() - this->start();
     std::size_t j = 0;
     for (std::size_t i=0; i < this->cpgOffset.size(); ++i) {
@@ -188,7 +302,7 @@ namespace methylFlow {
 	j++;
 
       // no more cpgs on other, so return true
-      if (j == this->cpgOffset.size()) return true;
+      if (j == other->cpgOffset.size()) return true;
 
       // check if pointers at same position
       if ( this->cpgOffset[i] - offset == other->cpgOffset[j] ) {
@@ -199,6 +313,20 @@ namespace methylFlow {
     return true;
   }
 
+  bool MethylRead::isMethConsistent(MethylRead *other)
+  {
+    // always assume comparing left read to right read
+    if (this->start() > other->start())
+      return false;
+
+    if (this->ncpgs() == 0 || other->ncpgs() == 0)
+      return true;
+
+    if (this->pack() && other->pack())
+      return isMethConsistentPacked(other);
+    return isMethConsistentOffsets(other);
+  }
+
   ReadComparison MethylRead::compare(MethylRead *other) {
     if (other->start() > this->end())
       return NONE;
@@ -225,7 +353,7 @@ namespace methylFlow {
     int offset = other->start() - this->start();
 
     std::size_t j = 0;
-    for (std::vector<int>::iterator i = this->cpgOffset.begin(); i != this->cpgOffset.end() && j < other->cpgOffset.size(); ++i) {
+    for (MFOffsetVector::iterator i = this->cpgOffset.begin(); i != this->cpgOffset.end() && j < other->cpgOffset.size(); ++i) {
       if (*i == (other->cpgOffset[j] + offset) ) {
 	++j;
       }
@@ -236,6 +364,53 @@ namespace methylFlow {
       this->methyl.push_back( other->methyl[j] );
     }
     this->rLen = offset + other->rLen;
+    offsets_changed();
+    return 0;
+  }
+
+  int MethylRead::merge(const std::vector<MethylRead *> &others)
+  {
+    std::size_t total = this->cpgOffset.size();
+    for (std::size_t k = 0; k < others.size(); ++k) {
+      total += others[k]->cpgOffset.size();
+    }
+    this->cpgOffset.reserve(total);
+    this->methyl.reserve(total);
+
+    // while our offsets are increasing, the scan for the offsets of the
+    // next read starts at the first that is not below its first one:
+    // merge(other) matches nothing before that
+    bool increasing = true;
+    for (std::size_t i = 1; i < this->cpgOffset.size() && increasing; ++i) {
+      increasing = this->cpgOffset[i - 1] < this->cpgOffset[i];
+    }
+
+    for (std::size_t k = 0; k < others.size(); ++k) {
+      const MethylRead *other = others[k];
+      const int offset = other->start() - this->start();
+
+      std::size_t i = 0, j = 0;
+      if (increasing && !other->cpgOffset.empty()) {
+        i = std::lower_bound(this->cpgOffset.begin(), this->cpgOffset.end(),
+                             other->cpgOffset[0] + offset) - this->cpgOffset.begin();
+      }
+      for (; i < this->cpgOffset.size() && j < other->cpgOffset.size(); ++i) {
+        if (this->cpgOffset[i] == (other->cpgOffset[j] + offset)) {
+          ++j;
+        }
+      }
+
+      const std::size_t first = this->cpgOffset.size();
+      for (; j < other->cpgOffset.size(); ++j) {
+        this->cpgOffset.push_back( other->cpgOffset[j] + offset );
+        this->methyl.push_back( other->methyl[j] );
+      }
+      for (i = std::max(first, (std::size_t) 1); i < this->cpgOffset.size() && increasing; ++i) {
+        increasing = this->cpgOffset[i - 1] < this->cpgOffset[i];
+      }
+      this->rLen = offset + other->rLen;
+    }
+    offsets_changed();
     return 0;
   }
 
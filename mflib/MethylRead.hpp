@@ -1,7 +1,10 @@
 #include <vector>
 #include <string>
+#include <stdint.h>
 #include <lemon/list_graph.h>
 
+#include "MFXMScanner.hpp"
+
 
 #ifndef METHYLREAD_H
 #define METHYLREAD_H
@@ -17,13 +20,28 @@ namespace methylFlow {
         MethylRead(int start, int length);
         MethylRead(const MethylRead &read);
         ~MethylRead();
+
+        // reads created with new and their cpg vectors come from the
+        // MFReadArena in scope on the calling thread, if any
+        static void *operator new(std::size_t size);
+        static void operator delete(void *p);
         
         float distance(MethylRead* other, int &common);
         bool isMethConsistent(MethylRead *other);
         ReadComparison compare(MethylRead *other);
-        int parseMethyl(std::string methylString);
+        // parse offset:[M|U] entries separated by commas, returns -1
+        // on a malformed string. the range version allocates nothing
+        // beyond growing cpgOffset and methyl once
+        int parseMethyl(const std::string &methylString);
+        int parseMethyl(const char *begin, const char *end);
         int parseXMtag(std::string XM);
+        // same as above over the tag value only (without XM:Z:)
+        // CHG/CHH calls are added to counts if given
+        int parseXMtag(const char *begin, const char *end, MFXMContextCounts *counts = NULL);
         int merge(MethylRead *other);
+        // merge others in order, with the same result as merging each
+        // in turn but growing cpgOffset and methyl once
+        int merge(const std::vector<MethylRead *> &others);
         void write();
         
         const std::string getMethString() const;
@@ -35,8 +53,20 @@ namespace methylFlow {
         const int end() const;
         const std::size_t ncpgs() const;
         
-        std::vector<int> cpgOffset;
-        std::vector<bool> methyl;
+        // cpg offsets and methylation calls in offset order, the bit
+        // masks used by compare are packed from these on first use
+        MFOffsetVector cpgOffset;
+        MFCallVector methyl;
+
+        // pack cpgOffset/methyl into bit masks, returns false if the
+        // offsets are not increasing and non-negative, in which case
+        // compare falls back to walking the offsets
+        bool pack();
+
+        // 64-bit hash of position, length, cpg offsets and calls
+        uint64_t fingerprint() const;
+        // same position, length, cpg offsets and calls
+        bool isDuplicate(const MethylRead *other) const;
 
         
     protected:
@@ -45,6 +75,20 @@ namespace methylFlow {
         //std::vector<int> cpgOffset;
         int coverage;
         lemon::ListDigraph::Node node;
+
+    private:
+        // bit k of word w is offset 64 * w + k: cpg masks in the first
+        // half of bits, methylation masks in the second
+        MFMaskVector bits;
+        std::size_t nwords;
+        // 1 packed, 0 not yet packed, -1 offsets cannot be packed
+        int packed;
+
+        // cpgOffset or methyl changed, masks are packed again on next use
+        void offsets_changed();
+
+        bool isMethConsistentPacked(const MethylRead *other) const;
+        bool isMethConsistentOffsets(const MethylRead *other) const;
     };
     
     inline const int MethylRead::start() const
@@ -68,6 +112,11 @@ namespace methylFlow {
         return this->cpgOffset.size();
     }
     
+    inline void MethylRead::offsets_changed()
+    {
+        packed = 0;
+    }
+    
     struct CompareReadStarts : public std::binary_function<MethylRead *, MethylRead *, bool>
     {
     public:
@@ -9,6 +9,7 @@
 #include <string>
 #include <sstream>
 #include <stdlib.h>
+#include <unistd.h>
 #include "simulator.h"
 
 std::ifstream inputFile;
@@ -61,6 +62,9 @@ int main (int argc, char* argv[]) {
    // shortReadFile.open(argv[3],std::ios_base::app);
     
     simulator * sim= new simulator();
+    if (argc > 3) {
+        sim->cpgIndexFile = argv[3];
+    }
     sim->simulate(inputFile, patternFile, shortReadFile);
     inputFile.close();
     patternFile.close();
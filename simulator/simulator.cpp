@@ -1,18 +1,19 @@
 // to be run :
 //./Simulate < input.in > /cbcb/project-scratch/fdorri/Code/methylFlow/testing/test0.tsv
-// dataFlag = 0  >>> read CpG sites from file
+//./mfSimulate input.in outdir [reference.fa.mfc], the CpG index is needed when dataFlag = 0
+// dataFlag = 0  >>> read CpG sites from the index written by mfCpgIndex
 // dataFlag > 0 >>>> dataFlag equals the number of cpg sites
 // dataFlag < 0 >>> read the data from rest of the file
 
 //freqFlag = 0 >>> randomly choose the frequency of each pattern
 //freqFlag = 1 >>> read the frequency of patterns from rest of the file(second line)
 #include "simulator.h"
+#include "mflib/MFCpgIndex.hpp"
 #include <math.h>
 #include <fstream>
 #include <iostream>
 
 //std::ofstream patternFile;
-std::ifstream methylPosFile;
 
 void simulator::readData(std::ifstream &inputFile){
     
@@ -75,43 +76,35 @@ void simulator::readData(std::ifstream &inputFile){
             }
         }
         
-        methylPosFile.open("/cbcb/project-scratch/fdorri/Code/Methylation/methylFlow/1_CpGInfo.txt");
-        vector<int> tempPos;
-        int s, p;
-        char t;
-        string dummyLine;
-        getline(methylPosFile, dummyLine);
-        int i = 0;
-        //while(!methylPosFile.eof()) {
-        while( i < 100){
-            i++;
-            methylPosFile >> s >> p >> t;
-            //dnaLength = max(dnaLength, s + p );
-            //dnaMin = min(dnaMin, s);
-            //cerr << "s " << s << " ,p " << p << endl;
-            //readLength = max(readLength, p);
-            if (s >= startDNA && s+p <= startDNA + dnaLength ){
-                tempPos.push_back(s + p);
-            }
+        // cpg sites of the simulated region from the reference index
+        methylFlow::MFCpgIndex cpgIndex;
+        if (cpgIndexFile.empty() || cpgIndex.open(cpgIndexFile) != 0) {
+            cerr << "cannot open CpG index " << cpgIndexFile << endl;
+            exit(1);
         }
-        sort(tempPos.begin(), tempPos.end());
-        pos.push_back(tempPos[0]);
-        for(int i=1; i < tempPos.size(); i++){
-            if(tempPos[i] != tempPos[i-1]){
-                pos.push_back(tempPos[i]);
-                cerr << tempPos[i] << endl;
-            }
+        stringstream chrName;
+        chrName << chr;
+        int contig = cpgIndex.contigs().lookup(chrName.str());
+        if (contig < 0) {
+            cerr << "chr " << chr << " is not in the CpG index" << endl;
+            exit(1);
+        }
+        uint64_t first, last;
+        cpgIndex.ordinal_range(contig, startDNA, startDNA + dnaLength, first, last);
+        for (uint64_t o = first; o < last; ++o) {
+            pos.push_back(cpgIndex.position(o));
+        }
+        if (pos.empty()) {
+            cerr << "no CpG sites in the simulated region" << endl;
+            exit(1);
         }
         cerr << "posSize " << pos.size()<< endl;
-        cerr << "tempposSize " << tempPos.size()<< endl;
         
         
         
         
         cerr << dnaLength << endl;
         cerr << readLength << endl;
-        
-        methylPosFile.close();
     }
     else{
         for(int i=0; i < HapNum; i++){
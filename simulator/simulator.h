@@ -29,6 +29,8 @@ struct MethylRead{
 class simulator {
 public:
     int chr, var;
+    // CpG index written by mfCpgIndex, used when dataFlag is 0
+    string cpgIndexFile;
     vector<int> freq;
     vector<int> pos;
     int dnaLength, startDNA, readLength, HapNum, freqFlag, coverage, error, dataFlag, corrDist;
@@ -0,0 +1,60 @@
+// reports BGZF decompression throughput (MB/s of decompressed data)
+// as the number of io threads increases
+// usage: benchBgzf [reads.bam] [copies] [max_threads]
+// the input is concatenated copies times into bench_reads.bam
+#include "mflib/MFBgzf.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <sys/time.h>
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "sorted_test.bam";
+    long copies = argc > 2 ? atol(argv[2]) : 50;
+    int max_threads = argc > 3 ? atoi(argv[3]) : 8;
+    const char *scaled = "bench_reads.bam";
+    
+    std::ifstream in(filename, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (content.empty()) {
+        std::cerr << "could not read " << filename << std::endl;
+        return 1;
+    }
+    
+    // concatenated BGZF files are a valid BGZF file
+    std::ofstream out(scaled, std::ios::binary);
+    for (long i = 0; i < copies; ++i) out << content;
+    out.close();
+    
+    std::vector<char> buf(1 << 20);
+    for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        double t0 = now();
+        methylFlow::MFBgzfReader reader;
+        if (reader.open(scaled, nthreads) != 0) {
+            std::cerr << "could not open " << scaled << std::endl;
+            return 1;
+        }
+        
+        long total = 0, n;
+        while ((n = reader.read(&buf[0], buf.size())) > 0) total += n;
+        if (n < 0) {
+            std::cerr << "decompression error after " << total << " bytes" << std::endl;
+            return 1;
+        }
+        double secs = now() - t0;
+        
+        std::cout << nthreads << " threads: " << total << " bytes in " << secs << " s, ";
+        std::cout << (total / secs) / (1 << 20) << " MB/s" << std::endl;
+    }
+    
+    remove(scaled);
+    return 0;
+}
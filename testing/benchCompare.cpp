@@ -0,0 +1,403 @@
+// compares MethylRead::compare with the bit masks against the previous
+// merge of the two offset lists, and one read against its active set
+// with all masks in one buffer against comparing one read at a time
+// usage: benchCompare [nreads] [read_length] [coverage]
+// reads are drawn from two haplotypes over a shared set of cpgs and every
+// read is compared with the reads starting up to one read length before it
+#include "mflib/MethylRead.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/time.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BENCH_X86 1
+#include <immintrin.h>
+#endif
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// MethylRead::isMethConsistent before the bit masks
+static bool consistent_offsets(const methylFlow::MethylRead *a, const methylFlow::MethylRead *b) {
+    if (a->start() > b->start()) return false;
+    if (a->ncpgs() == 0 || b->ncpgs() == 0) return true;
+
+    int offset = b->start() - a->start();
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < a->cpgOffset.size(); ++i) {
+        while (j < b->cpgOffset.size() && (a->cpgOffset[i] - offset) > b->cpgOffset[j]) j++;
+        if (j == b->cpgOffset.size()) return true;
+        if (a->cpgOffset[i] - offset == b->cpgOffset[j] && a->methyl[i] != b->methyl[j]) return false;
+    }
+    return true;
+}
+
+// MethylRead::compare before the bit masks
+static methylFlow::ReadComparison compare_offsets(const methylFlow::MethylRead *a, const methylFlow::MethylRead *b) {
+    if (b->start() > a->end()) return methylFlow::NONE;
+    if (!consistent_offsets(a, b)) return methylFlow::OVERLAP;
+    if (b->start() > a->start()) return b->end() <= a->end() ? methylFlow::SUBREAD : methylFlow::METHOVERLAP;
+    if (b->end() == a->end()) return methylFlow::IDENTICAL;
+    if (b->end() > a->end()) return methylFlow::SUPERREAD;
+    return methylFlow::SUBREAD;
+}
+
+// append the masks of read to words as the batch lays them out, returns
+// the number of words of each mask
+static int append_masks(const methylFlow::MethylRead *read, std::vector<uint64_t> &words) {
+    int n = read->ncpgs() ? read->cpgOffset.back() / 64 + 1 : 0;
+    std::size_t cpg = words.size();
+    words.resize(words.size() + 2 * n + 2, 0);
+    for (std::size_t i = 0; i < read->ncpgs(); ++i) {
+        int o = read->cpgOffset[i];
+        words[cpg + o / 64] |= (uint64_t) 1 << (o % 64);
+        if (read->methyl[i]) words[cpg + n + 1 + o / 64] |= (uint64_t) 1 << (o % 64);
+    }
+    return n;
+}
+
+// masks of the active reads copied next to each other: cpg words, a zero
+// word, methylation words, a zero word, so a shifted word can always
+// read its successor. erased reads are dropped once they are a quarter
+// of the entries
+struct MaskBatch {
+    std::vector<uint64_t> words, compacted;
+    // masks of the read compared against the batch
+    std::vector<uint64_t> probe;
+    std::vector<long> first;
+    std::vector<int> nwords, starts, ends;
+    std::vector<bool> erased;
+    std::size_t nlive;
+    std::vector<uint64_t> inconsistent;
+
+    MaskBatch() : nlive(0) {}
+
+    void clear() {
+        words.clear();
+        first.clear();
+        nwords.clear();
+        starts.clear();
+        ends.clear();
+        erased.clear();
+        nlive = 0;
+    }
+
+    void add(const methylFlow::MethylRead *read) {
+        first.push_back(words.size());
+        nwords.push_back(append_masks(read, words));
+        starts.push_back(read->start());
+        ends.push_back(read->end());
+        erased.push_back(false);
+        nlive++;
+    }
+
+    void erase(const std::size_t i) {
+        erased[i] = true;
+        nlive--;
+    }
+
+    void compact() {
+        std::size_t kept = 0;
+        compacted.clear();
+        for (std::size_t i = 0; i < first.size(); ++i) {
+            if (erased[i]) continue;
+            long at = compacted.size();
+            compacted.insert(compacted.end(), words.begin() + first[i], words.begin() + first[i] + 2 * nwords[i] + 2);
+            first[kept] = at;
+            nwords[kept] = nwords[i];
+            starts[kept] = starts[i];
+            ends[kept] = ends[i];
+            erased[kept] = false;
+            kept++;
+        }
+        words.swap(compacted);
+        first.resize(kept);
+        nwords.resize(kept);
+        starts.resize(kept);
+        ends.resize(kept);
+        erased.resize(kept);
+    }
+};
+
+// sets inconsistent[i] for entries [i, n) to the calls differing from
+// the masks cpg/meth (nw words) of a read starting at start
+static void batch_scalar_range(const MaskBatch &b, std::size_t i, const std::size_t n,
+                               const uint64_t *cpg, const uint64_t *meth, const int nw,
+                               const int start, uint64_t *inconsistent) {
+    for (; i < n; ++i) {
+        uint64_t acc = 0;
+        if (b.starts[i] <= start) {
+            const long offset = (long) start - b.starts[i];
+            const unsigned int shift = offset % 64;
+            const uint64_t *a_cpg = &b.words[b.first[i]];
+            const uint64_t *a_meth = a_cpg + b.nwords[i] + 1;
+            for (long k = 0, w = offset / 64; k < nw && w < b.nwords[i]; ++k, ++w) {
+                uint64_t c = a_cpg[w] >> shift;
+                uint64_t m = a_meth[w] >> shift;
+                if (shift != 0) {
+                    c |= a_cpg[w + 1] << (64 - shift);
+                    m |= a_meth[w + 1] << (64 - shift);
+                }
+                acc |= c & cpg[k] & (m ^ meth[k]);
+            }
+        }
+        inconsistent[i] = acc;
+    }
+}
+
+static void batch_scalar(const MaskBatch &b, const uint64_t *cpg, const uint64_t *meth,
+                         const int nw, const int start, uint64_t *inconsistent) {
+    batch_scalar_range(b, 0, b.first.size(), cpg, meth, nw, start, inconsistent);
+}
+
+#ifdef BENCH_X86
+// four reads per step, one per 64-bit lane, with per-lane shifts and
+// lanes past the end of their read masked out of the gathers
+__attribute__((target("avx2")))
+static void batch_avx2(const MaskBatch &b, const uint64_t *cpg, const uint64_t *meth,
+                       const int nw, const int start, uint64_t *inconsistent) {
+    const long long *base = reinterpret_cast<const long long *>(&b.words[0]);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i sixtyfour = _mm256_set1_epi64x(64);
+    const std::size_t n = b.first.size();
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        long long cpg_index[4], meth_index[4], word[4], shift[4], limit[4];
+        long steps = 0;
+        for (int l = 0; l < 4; ++l) {
+            const std::size_t j = i + l;
+            cpg_index[l] = meth_index[l] = word[l] = shift[l] = limit[l] = 0;
+            if (b.starts[j] > start) continue;
+
+            const long offset = (long) start - b.starts[j];
+            word[l] = offset / 64;
+            shift[l] = offset % 64;
+            limit[l] = b.nwords[j];
+            cpg_index[l] = b.first[j] + word[l];
+            meth_index[l] = b.first[j] + b.nwords[j] + 1 + word[l];
+            long lane_steps = limit[l] - word[l];
+            if (lane_steps > nw) lane_steps = nw;
+            if (lane_steps > steps) steps = lane_steps;
+        }
+
+        __m256i vcpg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cpg_index));
+        __m256i vmeth = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(meth_index));
+        __m256i vword = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(word));
+        const __m256i vlimit = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(limit));
+        const __m256i vshift = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(shift));
+        // a shift by 64 gives zero, so lanes with no shift ignore the next word
+        const __m256i vrshift = _mm256_sub_epi64(sixtyfour, vshift);
+        __m256i acc = _mm256_setzero_si256();
+
+        for (long k = 0; k < steps; ++k) {
+            const __m256i valid = _mm256_cmpgt_epi64(vlimit, vword);
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i lo = _mm256_mask_i64gather_epi64(zero, base, vcpg, valid, 8);
+            __m256i hi = _mm256_mask_i64gather_epi64(zero, base, _mm256_add_epi64(vcpg, one), valid, 8);
+            const __m256i a_cpg = _mm256_or_si256(_mm256_srlv_epi64(lo, vshift), _mm256_sllv_epi64(hi, vrshift));
+            lo = _mm256_mask_i64gather_epi64(zero, base, vmeth, valid, 8);
+            hi = _mm256_mask_i64gather_epi64(zero, base, _mm256_add_epi64(vmeth, one), valid, 8);
+            const __m256i a_meth = _mm256_or_si256(_mm256_srlv_epi64(lo, vshift), _mm256_sllv_epi64(hi, vrshift));
+
+            const __m256i b_cpg = _mm256_set1_epi64x((long long) cpg[k]);
+            const __m256i b_meth = _mm256_set1_epi64x((long long) meth[k]);
+            __m256i bad = _mm256_and_si256(_mm256_and_si256(a_cpg, b_cpg), _mm256_xor_si256(a_meth, b_meth));
+            acc = _mm256_or_si256(acc, _mm256_and_si256(bad, valid));
+
+            vcpg = _mm256_add_epi64(vcpg, one);
+            vmeth = _mm256_add_epi64(vmeth, one);
+            vword = _mm256_add_epi64(vword, one);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(inconsistent + i), acc);
+    }
+    batch_scalar_range(b, i, n, cpg, meth, nw, start, inconsistent);
+}
+#endif
+
+typedef void (*BatchFn)(const MaskBatch &, const uint64_t *, const uint64_t *, const int, const int, uint64_t *);
+
+// out[i] = (read of entry i)->compare(read) as MethylRead::compare
+// gives it, NONE for erased entries. entries are renumbered when the
+// erased ones are dropped first
+static void batch_compare(MaskBatch &b, BatchFn kernel, const methylFlow::MethylRead *read,
+                          std::vector<methylFlow::ReadComparison> &out) {
+    if (4 * (b.first.size() - b.nlive) > b.first.size()) b.compact();
+
+    const std::size_t n = b.first.size();
+    out.resize(n);
+    b.inconsistent.assign(n, 0);
+    if (read->ncpgs() != 0 && n != 0) {
+        b.probe.clear();
+        int nw = append_masks(read, b.probe);
+        kernel(b, &b.probe[0], &b.probe[nw + 1], nw, read->start(), &b.inconsistent[0]);
+    }
+
+    const int start = read->start();
+    const int end = read->end();
+    for (std::size_t i = 0; i < n; ++i) {
+        methylFlow::ReadComparison contained = end == b.ends[i] ? methylFlow::IDENTICAL : (end > b.ends[i] ? methylFlow::SUPERREAD : methylFlow::SUBREAD);
+        methylFlow::ReadComparison cmp = start > b.starts[i] ? (end <= b.ends[i] ? methylFlow::SUBREAD : methylFlow::METHOVERLAP) : contained;
+        cmp = (b.starts[i] > start || b.inconsistent[i] != 0) ? methylFlow::OVERLAP : cmp;
+        out[i] = (b.erased[i] || start > b.ends[i]) ? methylFlow::NONE : cmp;
+    }
+}
+
+static void report(const char *name, long ncompares, double secs) {
+    std::cout << name << ": " << (secs * 1e9 / ncompares) << " ns/compare, ";
+    std::cout << (ncompares / secs) / 1e6 << " M compares/s" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    long nreads = argc > 1 ? atol(argv[1]) : 20000;
+    int length = argc > 2 ? atoi(argv[2]) : 100;
+    int coverage = argc > 3 ? atoi(argv[3]) : 10;
+    int genome = nreads * length / coverage + length;
+
+    // one cpg every 12bp on average, two haplotypes differing on a third
+    srand(1);
+    std::vector<int> cpgs;
+    std::vector<bool> hap[2];
+    for (int pos = rand() % 12; pos < genome; pos += 1 + rand() % 23) {
+        bool m = rand() % 2;
+        cpgs.push_back(pos);
+        hap[0].push_back(m);
+        hap[1].push_back(rand() % 3 ? m : !m);
+    }
+
+    std::vector<int> starts(nreads);
+    for (long i = 0; i < nreads; ++i) starts[i] = 1 + rand() % (genome - length);
+    std::sort(starts.begin(), starts.end());
+
+    std::vector<methylFlow::MethylRead *> reads;
+    for (long i = 0; i < nreads; ++i) {
+        int h = rand() % 2;
+        std::ostringstream meth;
+        std::size_t c = std::lower_bound(cpgs.begin(), cpgs.end(), starts[i]) - cpgs.begin();
+        for (bool first = true; c < cpgs.size() && cpgs[c] < starts[i] + length; ++c, first = false) {
+            if (!first) meth << ",";
+            meth << cpgs[c] - starts[i] << ":" << (hap[h][c] ? "M" : "U");
+        }
+        methylFlow::MethylRead *m = new methylFlow::MethylRead(starts[i], length);
+        if (meth.str().size()) m->parseMethyl(meth.str());
+        reads.push_back(m);
+    }
+
+    // pairs as seen by processRead, left read against right read
+    std::vector<std::pair<int, int> > pairs;
+    for (long i = 0; i < nreads; ++i) {
+        for (long j = i - 1; j >= 0 && starts[i] - starts[j] < length; --j) {
+            pairs.push_back(std::make_pair(j, i));
+        }
+    }
+    if (pairs.empty()) {
+        std::cerr << "no overlapping reads" << std::endl;
+        return 1;
+    }
+    std::cout << nreads << " reads of " << length << "bp, " << pairs.size() << " overlapping pairs" << std::endl;
+
+    const int REPEATS = 10;
+    std::vector<int> expected(pairs.size());
+    double t0 = now();
+    for (int r = 0; r < REPEATS; ++r) {
+        for (std::size_t p = 0; p < pairs.size(); ++p) {
+            expected[p] = compare_offsets(reads[pairs[p].first], reads[pairs[p].second]);
+        }
+    }
+    report("offsets", REPEATS * pairs.size(), now() - t0);
+
+    // masks are packed on the first compare of a read, time it separately
+    t0 = now();
+    for (long i = 0; i < nreads; ++i) reads[i]->pack();
+    double pack_secs = now() - t0;
+
+    int mismatches = 0;
+    t0 = now();
+    for (int r = 0; r < REPEATS; ++r) {
+        for (std::size_t p = 0; p < pairs.size(); ++p) {
+            int res = reads[pairs[p].first]->compare(reads[pairs[p].second]);
+            if (res != expected[p]) mismatches++;
+        }
+    }
+    report("bit masks", REPEATS * pairs.size(), now() - t0);
+    std::cout << "packing: " << (pack_secs * 1e9 / nreads) << " ns/read" << std::endl;
+
+    // active set as kept by processRead: each read is compared with the
+    // reads before it, those ending before it starts are dropped and the
+    // read is added at the end
+    std::vector<methylFlow::ReadComparison> cmp;
+    std::vector<methylFlow::MethylRead *> active;
+    long nactive = 0;
+    t0 = now();
+    for (int r = 0; r < REPEATS; ++r) {
+        active.clear();
+        for (long i = 0; i < nreads; ++i) {
+            std::size_t kept = 0;
+            for (std::size_t j = 0; j < active.size(); ++j) {
+                if (active[j]->compare(reads[i]) != methylFlow::NONE) active[kept++] = active[j];
+            }
+            nactive += active.size();
+            active.resize(kept);
+            active.push_back(reads[i]);
+        }
+    }
+    report("active set, one at a time", nactive, now() - t0);
+
+    std::vector<std::pair<const char *, BatchFn> > kernels;
+    kernels.push_back(std::make_pair("scalar", batch_scalar));
+#ifdef BENCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(std::make_pair("avx2", batch_avx2));
+#endif
+    for (std::size_t k = 0; k < kernels.size(); ++k) {
+        MaskBatch batch;
+        t0 = now();
+        for (int r = 0; r < REPEATS; ++r) {
+            batch.clear();
+            for (long i = 0; i < nreads; ++i) {
+                batch_compare(batch, kernels[k].second, reads[i], cmp);
+                for (std::size_t e = 0; e < cmp.size(); ++e) {
+                    if (!batch.erased[e] && cmp[e] == methylFlow::NONE) batch.erase(e);
+                }
+                batch.add(reads[i]);
+            }
+        }
+        std::string name = std::string("active set, batch ") + kernels[k].first;
+        report(name.c_str(), nactive, now() - t0);
+
+        // same results as one at a time
+        batch.clear();
+        active.clear();
+        for (long i = 0; i < nreads; ++i) {
+            batch_compare(batch, kernels[k].second, reads[i], cmp);
+            std::size_t kept = 0, e = 0;
+            for (std::size_t j = 0; j < active.size(); ++j, ++e) {
+                while (batch.erased[e]) ++e;
+                if (cmp[e] != active[j]->compare(reads[i])) mismatches++;
+                if (cmp[e] == methylFlow::NONE) {
+                    batch.erase(e);
+                } else {
+                    active[kept++] = active[j];
+                }
+            }
+            active.resize(kept);
+            active.push_back(reads[i]);
+            batch.add(reads[i]);
+        }
+    }
+
+    for (long i = 0; i < nreads; ++i) delete reads[i];
+    if (mismatches) {
+        std::cerr << mismatches << " compares disagree" << std::endl;
+        return 1;
+    }
+    return 0;
+}
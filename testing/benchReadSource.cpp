@@ -0,0 +1,143 @@
+// reports reads per second for the istream and memory-mapped tsv readers
+// and the binary mfr loader, and the memory-mapped reader with reads
+// taken from a MFReadArena
+// usage: benchReadSource [reads.tsv] [copies]
+// the input is replicated copies times into bench_reads.tsv
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include "mflib/MFReadArena.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <sys/time.h>
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void report(const char *name, long nreads, double secs) {
+    std::cout << name << ": " << nreads << " reads in " << secs << " s, ";
+    std::cout << (long) (nreads / secs) << " reads/s" << std::endl;
+}
+
+static long drain(methylFlow::MFReadSource &source) {
+    methylFlow::MethylRead *m;
+    std::string readid;
+    int chr = 0;
+    long nreads = 0;
+    int res;
+    while ((res = source.next(m, readid, chr)) > 0) {
+        delete m;
+        nreads++;
+    }
+    if (res < 0) {
+        std::cerr << "parse error after " << nreads << " reads" << std::endl;
+        exit(1);
+    }
+    return nreads;
+}
+
+// reads are kept and freed a component at a time, as graphs do
+static long drain_components(methylFlow::MFReadSource &source, const std::size_t component_size) {
+    methylFlow::MethylRead *m;
+    std::string readid;
+    int chr = 0;
+    long nreads = 0;
+    std::vector<methylFlow::MethylRead *> component;
+    while (source.next(m, readid, chr) > 0) {
+        component.push_back(m);
+        nreads++;
+        if (component.size() == component_size) {
+            for (std::size_t i = 0; i < component.size(); ++i) delete component[i];
+            component.clear();
+        }
+    }
+    for (std::size_t i = 0; i < component.size(); ++i) delete component[i];
+    return nreads;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "sim1.tsv";
+    long copies = argc > 2 ? atol(argv[2]) : 1000000;
+    const char *scaled = "bench_reads.tsv";
+    
+    std::ifstream in(filename);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (content.empty()) {
+        std::cerr << "could not read " << filename << std::endl;
+        return 1;
+    }
+    if (content[content.size() - 1] != '\n') content += '\n';
+    
+    std::ofstream out(scaled);
+    for (long i = 0; i < copies; ++i) out << content;
+    out.close();
+    
+    double t0 = now();
+    std::ifstream input(scaled);
+    methylFlow::MFStreamReadSource stream_source(input, false);
+    long nreads = drain(stream_source);
+    report("istream", nreads, now() - t0);
+    
+    t0 = now();
+    methylFlow::MFMappedTSVReadSource mapped_source;
+    if (mapped_source.open(scaled) != 0) {
+        std::cerr << "could not map " << scaled << std::endl;
+        return 1;
+    }
+    nreads = drain(mapped_source);
+    report("mmap", nreads, now() - t0);
+    
+    t0 = now();
+    mapped_source.open(scaled);
+    nreads = drain_components(mapped_source, 3000);
+    report("mmap, components of 3000 reads", nreads, now() - t0);
+
+    t0 = now();
+    mapped_source.open(scaled);
+    {
+        methylFlow::MFReadArena arena;
+        methylFlow::MFReadArena::Scope scope(&arena);
+        nreads = drain_components(mapped_source, 3000);
+    }
+    report("mmap, components of 3000 reads, arena", nreads, now() - t0);
+    
+    // convert once, then load
+    const char *binary = "bench_reads.mfr";
+    mapped_source.open(scaled);
+    methylFlow::MFMfrWriter writer;
+    if (writer.open(binary) != 0) {
+        std::cerr << "could not write " << binary << std::endl;
+        return 1;
+    }
+    methylFlow::MethylRead *m;
+    std::string readid;
+    int chr = 0;
+    while (mapped_source.next(m, readid, chr) > 0) {
+        writer.write(*m, readid, chr);
+        delete m;
+    }
+    writer.close();
+    
+    t0 = now();
+    methylFlow::MFMfrReadSource mfr_source;
+    if (mfr_source.open(binary) != 0) {
+        std::cerr << "could not map " << binary << std::endl;
+        return 1;
+    }
+    nreads = drain(mfr_source);
+    report("mfr", nreads, now() - t0);
+    
+    std::ifstream tsv_size(scaled, std::ifstream::ate | std::ifstream::binary);
+    std::ifstream mfr_size(binary, std::ifstream::ate | std::ifstream::binary);
+    std::cout << "tsv " << tsv_size.tellg() << " bytes, mfr " << mfr_size.tellg() << " bytes" << std::endl;
+    
+    remove(binary);
+    remove(scaled);
+    return 0;
+}
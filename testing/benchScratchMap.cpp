@@ -0,0 +1,113 @@
+// per pass maps on a large component: a NodeMap/ArcMap allocated and
+// filled for every pass, as merge_chains and decompose did, against
+// MFScratchMap reset in O(1) and the residual flow read off the flows
+// usage: benchScratchMap [nnodes] [npasses]
+// the component is a chain where each node also overlaps the one after
+// next, each pass marks a short run of nodes or finds one path
+#include "mflib/MFGraph.hpp"
+#include "mflib/MFScratchMap.hpp"
+#include <lemon/dijkstra.h>
+#include <lemon/path.h>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <sys/time.h>
+
+using namespace lemon;
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void report(const char *name, long npasses, double secs) {
+    std::cout << name << ": " << (secs * 1e6 / npasses) << " us/pass" << std::endl;
+}
+
+typedef ShiftMap<NegMap<ListDigraph::ArcMap<float> > > ResidualMap;
+
+int main(int argc, char **argv) {
+    int nnodes = argc > 1 ? atoi(argv[1]) : 50000;
+    long npasses = argc > 2 ? atol(argv[2]) : 200;
+
+    ListDigraph g;
+    std::vector<ListDigraph::Node> nodes;
+    for (int i = 0; i < nnodes; ++i) nodes.push_back(g.addNode());
+    ListDigraph::ArcMap<float> flow(g);
+    srand(1);
+    for (int i = 0; i + 1 < nnodes; ++i) {
+        flow[g.addArc(nodes[i], nodes[i + 1])] = 1 + rand() % 50;
+        if (i + 2 < nnodes) flow[g.addArc(nodes[i], nodes[i + 2])] = 1 + rand() % 50;
+    }
+    const float total_flow = 100;
+    std::cout << nnodes << " nodes, " << countArcs(g) << " arcs" << std::endl;
+
+    // mark a run of nodes from a different start each pass
+    long marked = 0;
+    double t0 = now();
+    for (long pass = 0; pass < npasses; ++pass) {
+        ListDigraph::NodeMap<bool> reached(g, false);
+        int first = (pass * 7919) % (nnodes - 64);
+        for (int i = first; i < first + 64; ++i) reached[nodes[i]] = true;
+        marked += reached[nodes[first + 32]];
+    }
+    report("NodeMap<bool> per pass", npasses, now() - t0);
+
+    methylFlow::MFScratchMap<ListDigraph::Node, bool> scratch_reached(g, false);
+    t0 = now();
+    for (long pass = 0; pass < npasses; ++pass) {
+        scratch_reached.reset();
+        int first = (pass * 7919) % (nnodes - 64);
+        for (int i = first; i < first + 64; ++i) scratch_reached.set(nodes[i], true);
+        marked -= scratch_reached[nodes[first + 32]];
+    }
+    report("MFScratchMap<bool> reset per pass", npasses, now() - t0);
+
+    // one min-max path per pass, as in decompose, both map types must
+    // give the same path and not only the same bottleneck
+    float dist_allocated = 0;
+    Path<ListDigraph> path_allocated, path_scratch;
+    t0 = now();
+    for (long pass = 0; pass < npasses; ++pass) {
+        ListDigraph::ArcMap<float> residual_flow(g);
+        for (ListDigraph::ArcIt arc(g); arc != INVALID; ++arc) residual_flow[arc] = total_flow - flow[arc];
+        ListDigraph::NodeMap<float> dist(g);
+        Dijkstra<ListDigraph>
+        ::SetOperationTraits<methylFlow::DijkstraMinMaxOperationTraits<float> >
+        ::Create dijkstra(g, residual_flow);
+        dijkstra.distMap(dist);
+        dijkstra.run(nodes[0], nodes[nnodes - 1]);
+        dist_allocated += dijkstra.dist(nodes[nnodes - 1]);
+        path_allocated = dijkstra.path(nodes[nnodes - 1]);
+    }
+    report("decompose path, maps per pass", npasses, now() - t0);
+
+    float dist_scratch = 0;
+    methylFlow::MFScratchMap<ListDigraph::Node, float> scratch_dist(g);
+    t0 = now();
+    for (long pass = 0; pass < npasses; ++pass) {
+        NegMap<ListDigraph::ArcMap<float> > negative_flow(flow);
+        ResidualMap residual_flow(negative_flow, total_flow);
+        scratch_dist.reset();
+        Dijkstra<ListDigraph, ResidualMap>
+        ::SetOperationTraits<methylFlow::DijkstraMinMaxOperationTraits<float> >::Create
+        ::SetDistMap<methylFlow::MFScratchMap<ListDigraph::Node, float> >
+        ::Create dijkstra(g, residual_flow);
+        dijkstra.distMap(scratch_dist);
+        dijkstra.run(nodes[0], nodes[nnodes - 1]);
+        dist_scratch += dijkstra.dist(nodes[nnodes - 1]);
+        path_scratch = dijkstra.path(nodes[nnodes - 1]);
+    }
+    report("decompose path, scratch maps", npasses, now() - t0);
+
+    bool same_path = path_allocated.length() == path_scratch.length();
+    for (int i = 0; same_path && i < path_allocated.length(); ++i) {
+        same_path = path_allocated.nth(i) == path_scratch.nth(i);
+    }
+    if (marked != 0 || dist_allocated != dist_scratch || !same_path) {
+        std::cerr << "scratch maps disagree" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// compares the old find-based XM tag parser with the single pass scanners
+// usage: benchXMScan [nreads] [read_length]
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFXMScanner.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/time.h>
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// MethylRead::parseXMtag before the single pass scanner
+static void parse_xm_find(const std::string &XM, methylFlow::MFOffsetVector &cpgOffset, methylFlow::MFCallVector &methyl) {
+    std::size_t foundU, foundM, found;
+    std::size_t curStringOffset = XM.find("XM:Z:", 0) + 5;
+    while (curStringOffset < XM.length()) {
+        foundM = XM.find("Z", curStringOffset);
+        foundU = XM.find("z", curStringOffset);
+        found = std::min(foundM, foundU);
+        if (found == std::string::npos) break;
+        cpgOffset.push_back(found - 5);
+        methyl.push_back(XM[found] == 'Z');
+        curStringOffset = found + 1;
+    }
+}
+
+static void report(const char *name, long nreads, long nbytes, double secs) {
+    std::cout << name << ": " << (secs * 1e9 / nreads) << " ns/read, ";
+    std::cout << (nbytes / secs) / (1 << 20) << " MB/s" << std::endl;
+}
+
+// times all parsers on tags, returns 1 if any of them disagree
+static int run(const char *scenario, const std::vector<std::string> &tags, const long nreads, const int length) {
+    methylFlow::MFOffsetVector offsets, expected_offsets;
+    methylFlow::MFCallVector methyl, expected_methyl;
+    long nbytes = nreads * length;
+    long ncpgs = 0;
+    
+    std::cout << "[" << scenario << "]" << std::endl;
+    double t0 = now();
+    for (long i = 0; i < nreads; ++i) {
+        offsets.clear();
+        methyl.clear();
+        parse_xm_find(tags[i % tags.size()], offsets, methyl);
+        ncpgs += offsets.size();
+    }
+    report("find", nreads, nbytes, now() - t0);
+    
+    for (int impl = methylFlow::XM_SCAN_SCALAR; impl <= methylFlow::xm_scan_best(); ++impl) {
+        for (int with_counts = 0; with_counts < 2; ++with_counts) {
+            methylFlow::MFXMContextCounts counts;
+            long n = 0;
+            t0 = now();
+            for (long i = 0; i < nreads; ++i) {
+                const std::string &tag = tags[i % tags.size()];
+                offsets.clear();
+                methyl.clear();
+                methylFlow::scan_xm_tag(tag.data() + 5, tag.data() + tag.size(), offsets, methyl,
+                                        with_counts ? &counts : NULL, (methylFlow::XMScanImpl) impl);
+                n += offsets.size();
+            }
+            std::string name = methylFlow::xm_scan_name((methylFlow::XMScanImpl) impl);
+            if (with_counts) name += "+counts";
+            report(name.c_str(), nreads, nbytes, now() - t0);
+            
+            if (n != ncpgs) {
+                std::cerr << name << " found " << n << " CpGs, expected " << ncpgs << std::endl;
+                return 1;
+            }
+        }
+    }
+    
+    // full MethylRead::parseXMtag, including read construction
+    t0 = now();
+    for (long i = 0; i < nreads; ++i) {
+        methylFlow::MethylRead m(1, length);
+        m.parseXMtag(tags[i % tags.size()]);
+    }
+    report("parseXMtag", nreads, nbytes, now() - t0);
+    
+    for (std::size_t t = 0; t < tags.size(); ++t) {
+        methylFlow::MethylRead m(1, length);
+        m.parseXMtag(tags[t]);
+        expected_offsets.clear();
+        expected_methyl.clear();
+        parse_xm_find(tags[t], expected_offsets, expected_methyl);
+        if (m.cpgOffset != expected_offsets || m.methyl != expected_methyl) {
+            std::cerr << "parseXMtag differs on " << tags[t] << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// random tags, percent of CpG calls that are unmethylated given by unmeth
+static std::vector<std::string> make_tags(const int length, const int unmeth) {
+    std::vector<std::string> tags(1000);
+    for (std::size_t t = 0; t < tags.size(); ++t) {
+        std::string &tag = tags[t];
+        tag = "XM:Z:";
+        for (int i = 0; i < length; ++i) {
+            int r = rand() % 100;
+            if (r < 4) {
+                tag += (rand() % 100 < unmeth) ? 'z' : 'Z';
+            } else {
+                tag += r < 8 ? 'x' : r < 25 ? 'h' : r < 26 ? 'H' : '.';
+            }
+        }
+    }
+    return tags;
+}
+
+int main(int argc, char **argv) {
+    long nreads = argc > 1 ? atol(argv[1]) : 200000;
+    int length = argc > 2 ? atoi(argv[2]) : 250;
+    
+    srand(1);
+    if (run("mixed calls", make_tags(length, 30), nreads, length)) return 1;
+    // no 'z' at all: every find("z") rescans to the end of the tag
+    if (run("fully methylated", make_tags(length, 0), nreads, length)) return 1;
+    return 0;
+}
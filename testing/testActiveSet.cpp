@@ -0,0 +1,106 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFActiveSet.hpp"
+#include <lemon/list_graph.h>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// a node of the set as kept by the test
+struct Expected {
+    int id;
+    int start;
+    int end;
+    bool live;
+};
+
+int main() {
+    lemon::ListDigraph g;
+    methylFlow::MFActiveSet active;
+    std::vector<methylFlow::MFActiveSet::Entry> expired;
+    std::vector<methylFlow::MethylRead *> reads;
+    std::vector<Expected> expected;
+    assert(active.empty() && active.begin() == active.end());
+
+    // reads in start order, a few long ones hold the head of the window
+    // while the short ones after them expire, so the window is compacted
+    srand(5);
+    int ncompactions = 0;
+    int nreplaced = 0;
+    for (int pos = 1; pos <= 5000; ++pos) {
+        expired.clear();
+        std::size_t window = active.end() - active.begin();
+        active.expire(pos, expired);
+        if (active.end() - active.begin() < window && active.begin() == 0) ncompactions++;
+
+        // exactly the nodes whose reads end before pos leave
+        std::size_t nexpired = 0;
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            if (!expected[i].live || expected[i].end >= pos) continue;
+            expected[i].live = false;
+            nexpired++;
+            bool found = false;
+            for (std::size_t e = 0; e < expired.size(); ++e) {
+                if (lemon::ListDigraph::id(expired[e].node) == expected[i].id) found = true;
+            }
+            assert(found);
+        }
+        assert(expired.size() == nexpired);
+
+        // the window keeps the live nodes in start order and removed
+        // entries are at most half of it, plus some slack
+        std::size_t nlive = 0, j = 0;
+        for (std::size_t i = active.begin(); i != active.end(); ++i) {
+            if (active.removed(i)) continue;
+            while (!expected[j].live) ++j;
+            assert(lemon::ListDigraph::id(active[i].node) == expected[j].id);
+            assert(active[i].start == expected[j].start && active[i].end == expected[j].end);
+            assert(active[i].read->end() == active[i].end);
+            nlive++;
+            j++;
+        }
+        assert(nlive == active.size());
+        assert(active.end() <= 2 * active.size() + 64);
+        assert(active.upper_bound(pos - 1) == active.end());
+
+        if (rand() % 3 == 0) continue;
+        int length = rand() % 50 == 0 ? 2000 + rand() % 1000 : 1 + rand() % 60;
+        methylFlow::MethylRead *read = new methylFlow::MethylRead(pos, length);
+        reads.push_back(read);
+        lemon::ListDigraph::Node node = g.addNode();
+        methylFlow::MFActiveSet::Entry &entry = active.push_back(node, read);
+        assert(entry.slot == -1 && entry.start == pos);
+        Expected e = {lemon::ListDigraph::id(node), pos, read->end(), true};
+        expected.push_back(e);
+
+        // a read replaced by a longer one with the same start stays
+        // until the new read ends
+        if (rand() % 10 == 0) {
+            std::size_t i = active.begin() + rand() % (active.end() - active.begin());
+            if (active.removed(i)) continue;
+            methylFlow::MethylRead *longer = new methylFlow::MethylRead(active[i].start, active[i].read->length() + 1 + rand() % 100);
+            reads.push_back(longer);
+            active.set_read(i, longer);
+            for (std::size_t k = 0; k < expected.size(); ++k) {
+                if (expected[k].id == lemon::ListDigraph::id(active[i].node)) expected[k].end = longer->end();
+            }
+            nreplaced++;
+        }
+    }
+    assert(ncompactions > 0 && nreplaced > 0);
+
+    // reads starting at or before a position are found by binary search
+    std::size_t first = active.begin();
+    while (active.removed(first)) ++first;
+    std::size_t after = active.upper_bound(active[first].start);
+    assert(after > first);
+    for (std::size_t i = active.begin(); i != active.end(); ++i) {
+        assert((i < after) == (active[i].start <= active[first].start));
+    }
+
+    active.clear();
+    assert(active.empty() && active.begin() == active.end());
+    for (std::size_t i = 0; i < reads.size(); ++i) delete reads[i];
+    std::cout << ncompactions << " compactions, " << nreplaced << " replaced reads" << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFBamReadSource.hpp"
+#include <cassert>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "sorted_test.bam";
+    
+    methylFlow::MFBamReadSource source;
+    int res = source.open(filename);
+    assert(res == 0);
+    assert(source.contigs()->size() == 92);
+    assert(source.contigs()->name(0) == "chr1");
+    
+    std::string readid;
+    int chr = 0, lastChr = -1, lastStart = 0;
+    int nreads = 0;
+    methylFlow::MethylRead *m;
+    while ((res = source.next(m, readid, chr)) > 0) {
+        if (nreads == 0) {
+            // ..h..xhh.........xh.h...h....Z.h...Z
+            assert(readid == "SRR1097487.5015875_7068DAAXX100915:5:21:12072:14874_length=36");
+            assert(source.contigs()->name(chr) == "chr11");
+            assert(m->start() == 20003942);
+            assert(m->length() == 36);
+            assert(m->getMethString() == "29:M,35:M");
+        }
+        // input is coordinate sorted
+        if (chr == lastChr) {
+            assert(m->start() >= lastStart);
+        }
+        lastChr = chr;
+        lastStart = m->start();
+        nreads++;
+        delete m;
+    }
+    assert(res == 0);
+    assert(nreads == 50183);
+    
+    // threaded decompression delivers the same reads in the same order
+    methylFlow::MFBamReadSource threaded_source;
+    res = source.open(filename);
+    assert(res == 0);
+    res = threaded_source.open(filename, 4);
+    assert(res == 0);
+    
+    std::string id1, id2;
+    int chr1 = 0, chr2 = 0;
+    int nthreaded = 0;
+    while (true) {
+        methylFlow::MethylRead *m1, *m2;
+        res = source.next(m1, id1, chr1);
+        int threaded_res = threaded_source.next(m2, id2, chr2);
+        assert(res == threaded_res);
+        if (res <= 0) break;
+        
+        assert(id1 == id2);
+        assert(chr1 == chr2);
+        assert(m1->start() == m2->start());
+        assert(m1->getMethString() == m2->getMethString());
+        nthreaded++;
+        
+        delete m1;
+        delete m2;
+    }
+    assert(nthreaded == nreads);
+    
+    // range version matches the SAM tag parser
+    methylFlow::MethylRead m1(1, 36), m2(1, 36);
+    const std::string xm = "hhh....x......h.h..z....hh.........Z";
+    m1.parseXMtag("XM:Z:" + xm);
+    m2.parseXMtag(xm.data(), xm.data() + xm.size());
+    assert(m1.getMethString() == m2.getMethString());
+    
+    res = source.open("/nonexistent/reads.bam");
+    assert(res != 0);
+    
+    std::cout << nreads << " reads decoded" << std::endl;
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include "mflib/MFGraph.hpp"
+#include "mflib/MFContigRunner.hpp"
+#include "mflib/MFComponentRunner.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "test.sam";
+    const char *mfr_filename = "test_contigs.mfr";
+    
+    methylFlow::MFContigs contigs;
+    int id = contigs.add_header_line("@SQ\tSN:chr11\tLN:135006516");
+    assert(id == 0);
+    id = contigs.add_header_line("@SQ\tSN:chrX\tLN:155270560");
+    assert(id == 1);
+    id = contigs.add_header_line("@SQ\tLN:100");
+    assert(id == -1);
+    id = contigs.add("chr11");
+    assert(id == 0 && contigs.size() == 2);
+    assert(contigs.length(1) == 155270560);
+    assert(contigs.label(0) == "11" && contigs.label(1) == "X");
+    assert(contigs.find("X") == -1 && contigs.lookup("X") == 1 && contigs.lookup("11") == 0);
+    assert(methylFlow::contig_number("chr11") == 11 && methylFlow::contig_number("7") == 7);
+    
+    // contigs of the SAM header, alt contigs no longer share a chr
+    std::ifstream in(filename);
+    methylFlow::MFStreamReadSource sam_source(in, true);
+    methylFlow::MFMfrWriter writer;
+    std::string readid;
+    int chr = 0;
+    int nreads = 0;
+    int res;
+    methylFlow::MethylRead *m;
+    while ((res = sam_source.next(m, readid, chr)) > 0) {
+        if (nreads == 0) {
+            assert(sam_source.contigs()->size() == 92);
+            res = writer.open(mfr_filename, methylFlow::MFR_READ_IDS, sam_source.contigs());
+            assert(res == 0);
+        }
+        res = writer.write(*m, readid, chr);
+        assert(res == 0);
+        delete m;
+        nreads++;
+    }
+    res = writer.close();
+    assert(res == 0);
+    const methylFlow::MFContigs *sam_contigs = sam_source.contigs();
+    assert(sam_contigs->find("chr17") != sam_contigs->find("chr17_ctg5_hap1"));
+    assert(sam_contigs->find("chrX") != sam_contigs->find("chrY"));
+    
+    // the dictionary is kept in mfr files
+    methylFlow::MFMfrReadSource mfr_source;
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    const methylFlow::MFContigs *mfr_contigs = mfr_source.contigs();
+    assert(mfr_contigs->size() == sam_contigs->size());
+    for (std::size_t i = 0; i < mfr_contigs->size(); ++i) {
+        assert(mfr_contigs->name(i) == sam_contigs->name(i));
+        assert(mfr_contigs->length(i) == sam_contigs->length(i));
+    }
+    
+    // contigs run in parallel give the output of a serial run
+    std::ostringstream comp, patt, region;
+    methylFlow::MFGraph g;
+    res = g.run(mfr_source, comp, patt, region, 0, true, -1, 10, 0.1, false);
+    assert(res == 0);
+    assert(comp.str().find("\n17_ctg5_hap1\t") != std::string::npos);
+    
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    std::ostringstream par_comp, par_patt, par_region;
+    methylFlow::MFContigRunner runner(3);
+    res = runner.run(mfr_source, par_comp, par_patt, par_region, 0, true, -1, 10, 0.1, false);
+    assert(res == 0);
+    assert(par_comp.str() == comp.str());
+    assert(par_patt.str() == patt.str());
+    assert(par_region.str() == region.str());
+    
+    // so do components solved on a thread pool
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    std::ostringstream pool_comp, pool_patt, pool_region;
+    methylFlow::MFComponentRunner pool(3);
+    res = pool.run(mfr_source, pool_comp, pool_patt, pool_region, 0, true, -1, 10, 0.1, false);
+    assert(res == 0);
+    assert(pool.component_count() == g.component_count());
+    // components of single reads skip the LP
+    assert(g.closed_form_count() > 0 && g.closed_form_count() <= g.component_count());
+    assert(pool.closed_form_count() == g.closed_form_count());
+    assert(pool_comp.str() == comp.str());
+    assert(pool_patt.str() == patt.str());
+    assert(pool_region.str() == region.str());
+
+    // and components whose lambda grid is split across threads
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    methylFlow::MFSolverOptions options;
+    options.closed_form = false;
+    options.lambda_threads = 3;
+    options.lambda_threads_min_nodes = 0;
+    std::ostringstream split_comp, split_patt, split_region;
+    methylFlow::MFComponentRunner split(1);
+    split.set_solver_options(options);
+    res = split.run(mfr_source, split_comp, split_patt, split_region, 0, true, -1, 10, 0.1, false);
+    assert(res == 0);
+    assert(split_comp.str() == comp.str());
+    assert(split_patt.str() == patt.str());
+    assert(split_region.str() == region.str());
+
+    remove(mfr_filename);
+    std::cout << g.component_count() << " components match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFCpgIndex.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int main() {
+    const char *fasta_filename = "test_reference.fa";
+    const char *index_filename = "test_reference.fa.mfc";
+
+    // random contigs with lower case runs, CRLF line ends on one of
+    // them, CpGs across line breaks and a contig without CpGs
+    srand(7);
+    const char *names[] = { "chr1", "chr2", "chrX", "empty" };
+    const char *bases = "ACGTNacgt";
+    std::vector<std::string> seqs;
+    std::ofstream fasta(fasta_filename);
+    for (int c = 0; c < 4; ++c) {
+        std::string seq;
+        int len = c == 3 ? 50 : 1000 + rand() % 3000;
+        for (int i = 0; i < len; ++i) seq += c == 3 ? 'A' : bases[rand() % 9];
+        seqs.push_back(seq);
+        fasta << ">" << names[c] << " description of " << names[c] << (c == 1 ? "\r\n" : "\n");
+        for (int i = 0; i < len; i += 7 + c) {
+            fasta << seq.substr(i, 7 + c) << (c == 1 ? "\r\n" : "\n");
+        }
+    }
+    fasta.close();
+
+    int res = methylFlow::MFCpgIndex::build(fasta_filename, index_filename);
+    assert(res == 0);
+    methylFlow::MFCpgIndex index;
+    res = index.open(index_filename);
+    assert(res == 0);
+    assert(index.contigs().size() == 4);
+    assert(index.contigs().lookup("X") == 2);
+    assert(index.contig_ncpgs(3) == 0);
+
+    // 1-based positions of the C of each CpG, ordinals count across contigs
+    uint64_t ordinal = 0;
+    for (int c = 0; c < 4; ++c) {
+        assert(index.contigs().name(c) == names[c]);
+        assert(index.contigs().length(c) == (long) seqs[c].size());
+        std::vector<long> cpgs;
+        for (std::size_t i = 0; i + 1 < seqs[c].size(); ++i) {
+            if ((seqs[c][i] == 'C' || seqs[c][i] == 'c') && (seqs[c][i + 1] == 'G' || seqs[c][i + 1] == 'g')) {
+                cpgs.push_back(i + 1);
+            }
+        }
+        assert(index.contig_ncpgs(c) == cpgs.size());
+        for (std::size_t k = 0; k < cpgs.size(); ++k, ++ordinal) {
+            assert(index.position(ordinal) == cpgs[k]);
+            assert(index.contig_of(ordinal) == c);
+            assert(index.ordinal(c, cpgs[k]) == ordinal);
+            assert(index.ordinal(c, cpgs[k] - 1) == ordinal);
+            assert(index.is_cpg(c, cpgs[k]));
+            assert(!index.is_cpg(c, cpgs[k] + 1));
+        }
+        assert(index.ordinal(c, seqs[c].size() + 10) == ordinal);
+
+        // ranges against counting
+        for (int r = 0; r < 200; ++r) {
+            long start = rand() % (seqs[c].size() + 2);
+            long end = start + rand() % 200 - 20;
+            uint64_t first, last;
+            index.ordinal_range(c, start, end, first, last);
+            std::size_t expected = 0;
+            for (std::size_t k = 0; k < cpgs.size(); ++k) {
+                if (cpgs[k] >= start && cpgs[k] <= end) expected++;
+            }
+            assert(last - first == expected);
+            if (expected) assert(index.position(first) >= start && index.position(last - 1) <= end);
+        }
+    }
+    assert(index.ncpgs() == ordinal);
+
+    // reads on the reference get ordinals for their offsets
+    uint64_t first, last;
+    index.ordinal_range(0, 101, 200, first, last);
+    std::ostringstream meth;
+    for (uint64_t o = first; o < last; ++o) {
+        meth << (o == first ? "" : ",") << index.position(o) - 101 << ":M";
+    }
+    // and one offset that is not a CpG of the reference
+    long other = 101;
+    while (index.is_cpg(0, other)) other++;
+    meth << "," << other - 101 << ":U";
+    methylFlow::MethylRead read(101, 100);
+    read.parseMethyl(meth.str());
+    std::vector<uint64_t> ordinals;
+    int missing = index.read_ordinals(read, 0, ordinals);
+    assert(missing == 1);
+    assert(ordinals.size() == last - first);
+    for (std::size_t k = 0; k < ordinals.size(); ++k) assert(ordinals[k] == first + k);
+
+    // not an index
+    res = index.open(fasta_filename);
+    assert(res != 0);
+    std::remove(index_filename);
+    std::remove(fasta_filename);
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "mflib/MFGraph.hpp"
+#include "mflib/MFFrozenGraph.hpp"
+#include "mflib/MFScratchMap.hpp"
+#include <lemon/list_graph.h>
+#include <lemon/dijkstra.h>
+#include <lemon/maps.h>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace lemon;
+
+// a component built as decompose and regularize do: source and sink are
+// fake nodes and some nodes are erased along the way, so node and arc
+// ids are reused and differ from the order the ListDigraph iterates in
+class TestGraph : public methylFlow::MFGraph {
+public:
+    void build(const int nnodes)
+    {
+        source = addNode("s", 0);
+        fake[source] = true;
+        std::vector<ListDigraph::Node> nodes;
+        for (int i = 0; i < nnodes; ++i) {
+            std::ostringstream name;
+            name << i;
+            nodes.push_back(addNode(name.str(), 1 + rand() % 20));
+            normalized_coverage(nodes.back()) = (float) coverage(nodes.back()) / 3;
+            for (int j = 0; j < (int) nodes.size() - 1; ++j) {
+                if (rand() % 5 == 0) addArc(nodes[j], nodes.back(), 1 + rand() % 50);
+            }
+            // merged or collapsed nodes leave the graph
+            if (i > 2 && rand() % 4 == 0) {
+                int k = rand() % (nodes.size() - 1);
+                mfGraph.erase(nodes[k]);
+                nodes.erase(nodes.begin() + k);
+            }
+        }
+        sink = addNode("t", 0);
+        fake[sink] = true;
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            if (rand() % 3 == 0) addArc(source, nodes[i], 0);
+            if (rand() % 3 == 0) {
+                // a lambda node, as regularize adds for childless nodes
+                ListDigraph::Node lambda = addNode("l", 0);
+                fake[lambda] = true;
+                addArc(nodes[i], lambda, 1);
+                addArc(lambda, sink, 0);
+            }
+        }
+        for (ListDigraph::ArcIt a(mfGraph); a != INVALID; ++a) {
+            flow(a) = (float) (rand() % 100) / 7;
+        }
+    }
+
+    const ListDigraph::ArcMap<float> &flows() const
+    {
+        return flow_map;
+    }
+
+    bool is_fake(const ListDigraph::Node &node) const
+    {
+        return fake[node];
+    }
+
+    // nodes that are not fake, in FalseIt order
+    void real_nodes(std::vector<ListDigraph::Node> &nodes) const
+    {
+        for (IterableBoolMap<ListDigraph, ListDigraph::Node>::FalseIt v(fake); v != INVALID; ++v) {
+            nodes.push_back(v);
+        }
+    }
+};
+
+int main() {
+    srand(11);
+    for (int iter = 0; iter < 50; ++iter) {
+        TestGraph g;
+        g.build(1 + rand() % 60);
+        const ListDigraph &lg = g.get_graph();
+        methylFlow::MFFrozenGraph frozen;
+        frozen.freeze(g);
+
+        // nodes in NodeIt order with their attributes
+        int n = 0;
+        for (ListDigraph::NodeIt v(lg); v != INVALID; ++v, ++n) {
+            assert(frozen.node[n] == v);
+            assert(frozen.normalized_coverage[n] == g.normalized_coverage(v));
+            assert(frozen.fake[n] == g.is_fake(v));
+        }
+        assert(n == frozen.node_count());
+        assert(frozen.node[frozen.source()] == g.get_source());
+        assert(frozen.node[frozen.sink()] == g.get_sink());
+
+        // arcs in ArcIt order
+        int m = 0;
+        for (ListDigraph::ArcIt a(lg); a != INVALID; ++a, ++m) {
+            assert(frozen.arc[m] == a);
+            assert(frozen.node[frozen.arc_source[m]] == lg.source(a));
+            assert(frozen.node[frozen.arc_target[m]] == lg.target(a));
+            assert(frozen.effective_length[m] == g.effective_length(a));
+        }
+        assert(m == frozen.arc_count());
+
+        // each node's arcs in OutArcIt and InArcIt order
+        for (int i = 0; i < frozen.node_count(); ++i) {
+            int k = frozen.out_begin(i);
+            for (ListDigraph::OutArcIt a(lg, frozen.node[i]); a != INVALID; ++a, ++k) {
+                assert(k < frozen.out_end(i) && frozen.arc[frozen.out_arc(k)] == a);
+            }
+            assert(k == frozen.out_end(i));
+            k = frozen.in_begin(i);
+            for (ListDigraph::InArcIt a(lg, frozen.node[i]); a != INVALID; ++a, ++k) {
+                assert(k < frozen.in_end(i) && frozen.arc[frozen.in_arc(k)] == a);
+            }
+            assert(k == frozen.in_end(i));
+        }
+
+        // real nodes in the order of the LP's arc rows
+        std::vector<ListDigraph::Node> real;
+        g.real_nodes(real);
+        assert(real.size() == frozen.real_nodes().size());
+        for (std::size_t i = 0; i < real.size(); ++i) {
+            assert(frozen.node[frozen.real_nodes()[i]] == real[i]);
+        }
+
+        // expected coverage over the frozen arcs matches the graph's
+        for (int a = 0; a < frozen.arc_count(); ++a) frozen.flow[a] = g.flow(frozen.arc[a]);
+        for (int i = 0; i < frozen.node_count(); ++i) {
+            assert(frozen.expected_coverage(i, 10.) == g.expected_coverage(frozen.node[i], 10.));
+        }
+
+        // min-max paths match lemon's Dijkstra, ties included, also once
+        // arcs are removed (erased from the ListDigraph)
+        typedef ShiftMap<NegMap<ListDigraph::ArcMap<float> > > ResidualMap;
+        typedef Dijkstra<ListDigraph, ResidualMap>
+        ::SetOperationTraits<methylFlow::DijkstraMinMaxOperationTraits<float> >::Create
+        ::SetDistMap<methylFlow::MFScratchMap<ListDigraph::Node, float> >::Create MinMaxDijkstra;
+        ListDigraph &mg = g.get_graph();
+        std::vector<char> removed(frozen.arc_count(), 0);
+        std::vector<int> path;
+        methylFlow::MFScratchMap<ListDigraph::Node, float> dist(mg);
+        for (int pass = 0; pass < 4; ++pass) {
+            // rounded flows tie often
+            for (int a = 0; a < frozen.arc_count(); ++a) {
+                if (!removed[a]) g.flow(frozen.arc[a]) = frozen.flow[a] = (float) (rand() % 8);
+            }
+            const float total = 10;
+            const float d = frozen.min_max_path(total, removed, path);
+
+            NegMap<ListDigraph::ArcMap<float> > negative_flow(g.flows());
+            ResidualMap residual(negative_flow, total);
+            dist.reset();
+            MinMaxDijkstra dijkstra(mg, residual);
+            dijkstra.distMap(dist);
+            dijkstra.run(g.get_source(), g.get_sink());
+            assert(d == dijkstra.dist(g.get_sink()));
+            Path<ListDigraph> lemon_path = dijkstra.path(g.get_sink());
+            assert((int) path.size() == lemon_path.length());
+            for (int i = 0; i < lemon_path.length(); ++i) {
+                assert(frozen.arc[path[i]] == lemon_path.nth(i));
+            }
+
+            for (int a = 0; a < frozen.arc_count(); ++a) {
+                if (!removed[a] && rand() % 4 == 0) {
+                    removed[a] = 1;
+                    mg.erase(frozen.arc[a]);
+                }
+            }
+        }
+    }
+    std::cout << "frozen graphs match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "mflib/MFGraph.hpp"
+#include "mflib/MFSolverOptions.hpp"
+#include <lemon/list_graph.h>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace lemon;
+
+// a component source -> a -> b -> sink as add_terminals leaves it,
+// solved by the LP. with L(a) = 3 / scale and L(b) = 1 / scale the
+// scaled lengths of the arcs out of a and (after regularize) out of b,
+// and flow f along the one path, the optimal value is
+//   V(lambda) = min over f of |c(a) - L(a) f| + |c(b) - L(b) f| + lambda f
+// which, for c(a) / L(a) > c(b) / L(b) and L(a) > L(b), takes
+//   f = c(a) / L(a) for lambda < L(a) - L(b), deviance L(b) c(a) / L(a) - c(b)
+//   f = c(b) / L(b) for L(a) - L(b) < lambda < L(a) + L(b), deviance L(a) (c(a) / L(a) - c(b) / L(b))
+//   f = 0 above, deviance c(a) + c(b)
+class TestGraph : public methylFlow::MFGraph {
+public:
+    void build(const float coverage_a, const float coverage_b)
+    {
+        source = addNode("s", 0);
+        fake[source] = true;
+        ListDigraph::Node a = addNode("a", 1);
+        normalized_coverage(a) = coverage_a;
+        ListDigraph::Node b = addNode("b", 1);
+        normalized_coverage(b) = coverage_b;
+        sink = addNode("t", 0);
+        fake[sink] = true;
+        addArc(source, a, 0);
+        addArc(a, b, 3);
+        addArc(b, sink, 0);
+    }
+
+    // best lambda and its deviance as reported by the search
+    int search(const methylFlow::MFLambdaSearch search, const float scale,
+               double &lambda, double &deviance)
+    {
+        methylFlow::MFSolverOptions options;
+        options.lambda_search = search;
+        set_solver_options(options);
+
+        std::ostringstream out;
+        std::streambuf *cout_buf = std::cout.rdbuf(out.rdbuf());
+        int res = solve(-1, scale, 0.1, true);
+        std::cout.rdbuf(cout_buf);
+
+        const std::string text = out.str();
+        const std::string found = "best lamda found ";
+        std::size_t pos = text.find(found);
+        if (res != 0 || pos == std::string::npos) return -1;
+        std::istringstream line(text.substr(pos + found.size()));
+        std::string label;
+        line >> lambda;
+        std::getline(line, label, '=');
+        line >> deviance;
+        return line ? 0 : -1;
+    }
+
+    // flow of every arc is f
+    bool uniform_flow(const float f) const
+    {
+        for (ListDigraph::ArcIt arc(mfGraph); arc != INVALID; ++arc) {
+            if (fabs(flow(arc) - f) > 1e-3 * f) return false;
+        }
+        return true;
+    }
+};
+
+// output of a run over filename with the given lambda search, all
+// components solved with the LP
+static int run(const char *filename, const bool flag_SAM, const methylFlow::MFLambdaSearch search,
+               std::string &comp, std::string &patt, std::string &region)
+{
+    methylFlow::MFSolverOptions options;
+    options.lambda_search = search;
+    options.closed_form = false;
+    methylFlow::MFGraph g;
+    g.set_solver_options(options);
+
+    std::ifstream in(filename);
+    std::ostringstream comp_stream, patt_stream, region_stream;
+    int res = g.run(in, comp_stream, patt_stream, region_stream, 0, flag_SAM, -1, 10, 0.1, false);
+    assert(res == 0);
+    comp = comp_stream.str();
+    patt = patt_stream.str();
+    region = region_stream.str();
+    return g.component_count();
+}
+
+int main(int argc, char **argv) {
+    const char *tsv_filename = argc > 1 ? argv[1] : "sim1.tsv";
+    const char *sam_filename = argc > 2 ? argv[2] : "test.sam";
+
+    // with scale 10, L(a) = 0.3 and L(b) = 0.1: the deviance is 7/3 up to
+    // lambda = 0.2, strictly between the grid points 2^-2.5 and 2^-2, and
+    // 7 after it, which fails the threshold. the path search stops at the
+    // breakpoint, the grid at the point below it, both with f = c(a) / L(a)
+    const double scale = 10, coverage_a = 10, coverage_b = 1;
+    const double best_deviance = 0.1 * coverage_a / 0.3 - coverage_b;
+    double lambda, deviance;
+    TestGraph path_graph;
+    path_graph.build(coverage_a, coverage_b);
+    int res = path_graph.search(methylFlow::LAMBDA_PATH, scale, lambda, deviance);
+    assert(res == 0);
+    assert(fabs(lambda - 0.2) < 1e-5);
+    assert(fabs(deviance - best_deviance) < 1e-4);
+    assert(path_graph.uniform_flow(coverage_a / 0.3));
+
+    TestGraph grid_graph;
+    grid_graph.build(coverage_a, coverage_b);
+    res = grid_graph.search(methylFlow::LAMBDA_GRID, scale, lambda, deviance);
+    assert(res == 0);
+    assert(fabs(lambda - pow(2., -2.5)) < 1e-5);
+    assert(fabs(deviance - best_deviance) < 1e-4);
+    assert(grid_graph.uniform_flow(coverage_a / 0.3));
+
+    // on these inputs the breakpoint the path search stops at and the
+    // largest grid point passing the threshold share their solution
+    std::string comp, patt, region;
+    std::string path_comp, path_patt, path_region;
+    int ncomponents = run(tsv_filename, false, methylFlow::LAMBDA_GRID, comp, patt, region);
+    int path_ncomponents = run(tsv_filename, false, methylFlow::LAMBDA_PATH, path_comp, path_patt, path_region);
+    assert(ncomponents > 0 && path_ncomponents == ncomponents);
+    assert(path_comp == comp);
+    assert(path_patt == patt);
+    assert(path_region == region);
+
+    ncomponents = run(sam_filename, true, methylFlow::LAMBDA_GRID, comp, patt, region);
+    path_ncomponents = run(sam_filename, true, methylFlow::LAMBDA_PATH, path_comp, path_patt, path_region);
+    assert(ncomponents > 0 && path_ncomponents == ncomponents);
+    assert(path_comp == comp);
+    assert(path_patt == patt);
+    assert(path_region == region);
+
+    std::cout << "lambda path matches the grid" << std::endl;
+    return 0;
+}
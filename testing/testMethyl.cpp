@@ -1,6 +1,22 @@
 #include "mflib/MethylRead.hpp"
+#include "mflib/MFXMScanner.hpp"
+#include "mflib/MFReadArena.hpp"
 #include <cassert>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+
+// calls of the two reads agree on every shared cpg
+static bool consistent_reference(methylFlow::MethylRead &a, methylFlow::MethylRead &b) {
+    if (a.start() > b.start()) return false;
+    int offset = b.start() - a.start();
+    for (std::size_t i = 0; i < a.cpgOffset.size(); ++i) {
+        for (std::size_t j = 0; j < b.cpgOffset.size(); ++j) {
+            if (a.cpgOffset[i] - offset == b.cpgOffset[j] && a.methyl[i] != b.methyl[j]) return false;
+        }
+    }
+    return true;
+}
 
 int main() {
     methylFlow::MethylRead m1(3, 10);
@@ -55,5 +71,148 @@ int main() {
     v->parseMethyl("7:M,10:M");
     assert(u->compare(v) == methylFlow::METHOVERLAP);
     
+    // merging a chain of reads at once matches merging them in turn
+    methylFlow::MethylRead c1(1, 20), c2(5, 20), c3(9, 20), c4(12, 4);
+    c1.parseMethyl("2:M,6:U,10:M,14:U");
+    c2.parseMethyl("2:U,6:M,10:U,14:M,18:U");
+    c3.parseMethyl("2:M,6:U,10:M,17:M");
+    c4.parseMethyl("3:U");
+    methylFlow::MethylRead one(c1), all(c1);
+    one.merge(&c2);
+    one.merge(&c3);
+    one.merge(&c4);
+    std::vector<methylFlow::MethylRead *> chain;
+    chain.push_back(&c2);
+    chain.push_back(&c3);
+    chain.push_back(&c4);
+    all.merge(chain);
+    assert(all.length() == one.length());
+    assert(all.getMethString() == one.getMethString());
+    
+    // fingerprints of duplicates match, a different call or end does not
+    assert(m1.isDuplicate(&m2) && m1.fingerprint() == m2.fingerprint());
+    assert(!m1.isDuplicate(&m3) && m1.fingerprint() != m3.fingerprint());
+    methylFlow::MethylRead m9(3, 10);
+    m9.parseMethyl("6:M,8:U");
+    assert(!m1.isDuplicate(&m9) && m1.fingerprint() != m9.fingerprint());
+
+    // the right read has fewer cpgs than the left one
+    methylFlow::MethylRead l1(1, 40);
+    l1.parseMethyl("2:M,5:M,9:U,30:M");
+    methylFlow::MethylRead r1(5, 10);
+    r1.parseMethyl("5:M");
+    assert(l1.isMethConsistent(&r1) == false);
+
+    // a read without cpgs packs to empty masks and agrees with any read
+    methylFlow::MethylRead e1(3, 10);
+    assert(e1.pack());
+    assert(m1.pack());
+    assert(e1.compare(&m1) == methylFlow::IDENTICAL);
+    assert(m1.compare(&e1) == methylFlow::IDENTICAL);
+    assert(e1.compare(&m5) == methylFlow::METHOVERLAP);
+
+    // bit masks agree with the offsets, also across word boundaries
+    srand(2);
+    for (int iter = 0; iter < 20000; ++iter) {
+        methylFlow::MethylRead *reads[2];
+        for (int r = 0; r < 2; ++r) {
+            int len = 1 + rand() % 300;
+            std::ostringstream meth;
+            int ncpgs = 0;
+            for (int pos = rand() % 8; pos < len; pos += 1 + rand() % 12) {
+                if (ncpgs++) meth << ",";
+                meth << pos << ":" << ((rand() % 8) ? "M" : "U");
+            }
+            reads[r] = new methylFlow::MethylRead(1 + rand() % 200, len);
+            if (ncpgs) reads[r]->parseMethyl(meth.str());
+        }
+        assert(reads[0]->isMethConsistent(reads[1]) == consistent_reference(*reads[0], *reads[1]));
+        assert(reads[1]->isMethConsistent(reads[0]) == consistent_reference(*reads[1], *reads[0]));
+        delete reads[0];
+        delete reads[1];
+    }
+    
+    // reads and their cpg vectors from an arena, chunks are released
+    // once all their reads are freed, also after the arena is gone
+    {
+        methylFlow::MFArenaStats before = methylFlow::arena_stats();
+        std::vector<methylFlow::MethylRead *> reads;
+        {
+            methylFlow::MFReadArena arena(4096);
+            methylFlow::MFReadArena::Scope scope(&arena);
+            for (int i = 0; i < 500; ++i) {
+                methylFlow::MethylRead *m = new methylFlow::MethylRead(1 + i, 50);
+                m->parseMethyl("1:M,5:U,9:M,20:U");
+                reads.push_back(m);
+            }
+            arena.publish_stats();
+            methylFlow::MFArenaStats stats = methylFlow::arena_stats();
+            assert(stats.allocations - before.allocations >= 1500);
+            assert(stats.chunks_allocated - before.chunks_allocated > 1);
+        }
+        // copies made outside a scope come from the heap
+        methylFlow::MethylRead copy(*reads[0]);
+        assert(copy.getMethString() == reads[0]->getMethString());
+        assert(reads[0]->compare(reads[1]) == reads[1]->compare(reads[2]));
+
+        for (std::size_t i = 0; i < reads.size(); ++i) delete reads[i];
+        methylFlow::MFArenaStats after = methylFlow::arena_stats();
+        assert(after.chunks_allocated - before.chunks_allocated == after.chunks_released - before.chunks_released);
+    }
+
+    // parser edge cases, as handled by the original string parser
+    methylFlow::MethylRead p1(1, 20);
+    int res = p1.parseMethyl("6:M,8:U,");
+    assert(res == 0 && p1.getMethString() == "6:M,8:U");
+    
+    methylFlow::MethylRead p2(1, 20);
+    res = p2.parseMethyl(" 7:M,x:M,9:Mx,10:");
+    assert(res == 0 && p2.getMethString() == "7:M,0:M,9:U,10:U");
+    
+    methylFlow::MethylRead p3(1, 20);
+    res = p3.parseMethyl("");
+    assert(res == -1 && p3.ncpgs() == 0);
+    
+    methylFlow::MethylRead p4(1, 20);
+    res = p4.parseMethyl("6:M,8");
+    assert(res == -1 && p4.getMethString() == "6:M");
+    
+    methylFlow::MethylRead x1(1, 36);
+    x1.parseXMtag("XM:Z:..h..xhh.........xh.h...h....Z.h..zZ");
+    assert(x1.getMethString() == "29:M,34:U,35:M");
+    
+    methylFlow::MFXMContextCounts counts;
+    const std::string xm = "..h..xHh.........Xh.h...h....Z.h...z";
+    methylFlow::MethylRead x2(1, 36);
+    x2.parseXMtag(xm.data(), xm.data() + xm.size(), &counts);
+    assert(x2.getMethString() == "29:M,35:U");
+    assert(counts.chg_methylated == 1 && counts.chg_unmethylated == 1);
+    assert(counts.chh_methylated == 1 && counts.chh_unmethylated == 6);
+    
+    // SIMD scanners agree with the scalar one on all lengths and tails
+    const char alphabet[] = ".zZxXhHuU";
+    srand(1);
+    for (int len = 0; len < 300; ++len) {
+        std::string tag(len, '.');
+        for (int i = 0; i < len; ++i) tag[i] = alphabet[rand() % 9];
+        
+        methylFlow::MFOffsetVector offsets0;
+        methylFlow::MFCallVector methyl0;
+        methylFlow::MFXMContextCounts counts0;
+        methylFlow::scan_xm_tag(tag.data(), tag.data() + len, offsets0, methyl0, &counts0, methylFlow::XM_SCAN_SCALAR);
+        
+        for (int impl = methylFlow::XM_SCAN_SSE2; impl <= methylFlow::XM_SCAN_AVX2; ++impl) {
+            methylFlow::MFOffsetVector offsets1;
+            methylFlow::MFCallVector methyl1;
+            methylFlow::MFXMContextCounts counts1;
+            methylFlow::scan_xm_tag(tag.data(), tag.data() + len, offsets1, methyl1, &counts1, (methylFlow::XMScanImpl) impl);
+            assert(offsets0 == offsets1 && methyl0 == methyl1);
+            assert(counts0.chg_methylated == counts1.chg_methylated);
+            assert(counts0.chg_unmethylated == counts1.chg_unmethylated);
+            assert(counts0.chh_methylated == counts1.chh_methylated);
+            assert(counts0.chh_unmethylated == counts1.chh_unmethylated);
+        }
+    }
+    
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "sim2.tsv";
+    const char *mfr_filename = "test_reads.mfr";
+    
+    // small blocks and a chromosome change every 100 reads
+    methylFlow::MFMappedTSVReadSource tsv_source;
+    int res = tsv_source.open(filename);
+    assert(res == 0);
+    methylFlow::MFMfrWriter writer(64);
+    res = writer.open(mfr_filename);
+    assert(res == 0);
+    
+    std::string readid;
+    int chr = 0;
+    int nreads = 0;
+    methylFlow::MethylRead *m;
+    while ((res = tsv_source.next(m, readid, chr)) > 0) {
+        res = writer.write(*m, readid, nreads / 100);
+        assert(res == 0);
+        delete m;
+        nreads++;
+    }
+    assert(nreads > 0);
+    res = writer.close();
+    assert(res == 0);
+    
+    res = tsv_source.open(filename);
+    assert(res == 0);
+    methylFlow::MFMfrReadSource mfr_source;
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    
+    std::string id1, id2;
+    int nloaded = 0;
+    while (true) {
+        methylFlow::MethylRead *m1, *m2;
+        res = tsv_source.next(m1, id1, chr);
+        int mfr_res = mfr_source.next(m2, id2, chr);
+        assert(res == mfr_res);
+        if (res <= 0) break;
+        
+        assert(id1 == id2);
+        assert(chr == nloaded / 100);
+        assert(m1->start() == m2->start());
+        assert(m1->length() == m2->length());
+        assert(m1->cpgOffset == m2->cpgOffset);
+        assert(m1->methyl == m2->methyl);
+        nloaded++;
+        
+        delete m1;
+        delete m2;
+    }
+    assert(nloaded == nreads);
+    
+    // without read ids
+    methylFlow::MethylRead r(10, 36);
+    r.parseMethyl("2:M,30:U");
+    res = writer.open(mfr_filename, 0);
+    assert(res == 0);
+    res = writer.write(r, "aread1", 1);
+    assert(res == 0);
+    res = writer.close();
+    assert(res == 0);
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    res = mfr_source.next(m, readid, chr);
+    assert(res == 1);
+    assert(readid.empty() && chr == 1);
+    assert(m->start() == 10 && m->getMethString() == "2:M,30:U");
+    delete m;
+    res = mfr_source.next(m, readid, chr);
+    assert(res == 0);
+    
+    // text input is rejected
+    res = mfr_source.open(filename);
+    assert(res != 0);
+    
+    remove(mfr_filename);
+    std::cout << nloaded << " reads match" << std::endl;
+    return 0;
+}
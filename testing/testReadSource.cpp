@@ -0,0 +1,96 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFPipelinedReadSource.hpp"
+#include "mflib/MFSpscQueue.hpp"
+#include <cassert>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv) {
+    const char *filename = argc > 1 ? argv[1] : "sim2.tsv";
+    
+    std::ifstream input(filename);
+    assert(input);
+    methylFlow::MFStreamReadSource stream_source(input, false);
+    
+    methylFlow::MFMappedTSVReadSource mapped_source;
+    int res = mapped_source.open(filename);
+    assert(res == 0);
+    
+    std::string id1, id2;
+    int chr1 = 0, chr2 = 0;
+    int nreads = 0;
+    while (true) {
+        methylFlow::MethylRead *m1, *m2;
+        res = stream_source.next(m1, id1, chr1);
+        int mapped_res = mapped_source.next(m2, id2, chr2);
+        assert(res == mapped_res);
+        if (res <= 0) break;
+        
+        assert(id1 == id2);
+        assert(m1->start() == m2->start());
+        assert(m1->length() == m2->length());
+        assert(m1->cpgOffset == m2->cpgOffset);
+        assert(m1->methyl == m2->methyl);
+        nreads++;
+        
+        delete m1;
+        delete m2;
+    }
+    assert(nreads > 0);
+    
+    // pipelined source delivers the same reads, small batches
+    // and queue make the parser wait on the consumer
+    res = mapped_source.open(filename);
+    assert(res == 0);
+    std::ifstream input2(filename);
+    methylFlow::MFStreamReadSource stream_source2(input2, false);
+    methylFlow::MFPipelinedReadSource pipelined_source(mapped_source, 3, 2);
+    int npipelined = 0;
+    chr1 = chr2 = 7;
+    while (true) {
+        methylFlow::MethylRead *m1, *m2;
+        res = stream_source2.next(m1, id1, chr1);
+        int pipelined_res = pipelined_source.next(m2, id2, chr2);
+        assert(res == pipelined_res);
+        if (res <= 0) break;
+        
+        assert(id1 == id2);
+        assert(chr2 == 7);
+        assert(m1->start() == m2->start());
+        assert(m1->cpgOffset == m2->cpgOffset);
+        assert(m1->methyl == m2->methyl);
+        npipelined++;
+        
+        delete m1;
+        delete m2;
+    }
+    assert(npipelined == nreads);
+    methylFlow::MethylRead *last;
+    res = pipelined_source.next(last, id2, chr2);
+    assert(res == 0);
+    
+    methylFlow::MFSpscQueue<int> queue(3);
+    assert(queue.capacity() == 4);
+    int item;
+    for (int i = 0; i < 4; ++i) {
+        bool pushed = queue.push(i);
+        assert(pushed);
+    }
+    bool pushed = queue.push(4);
+    assert(!pushed);
+    bool popped = queue.pop(item);
+    assert(popped && item == 0);
+    
+    // files that can't be mapped are left to the stream reader
+    res = mapped_source.open("/nonexistent/reads.tsv");
+    assert(res != 0);
+    
+    methylFlow::MethylRead m(3, 10);
+    const char meth[] = "6:M,8:U";
+    m.parseMethyl(meth, meth + sizeof(meth) - 1);
+    assert(m.getMethString() == "6:M,8:U");
+    
+    std::cout << nreads << " reads match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "mflib/MethylRead.hpp"
+#include "mflib/MFReadSource.hpp"
+#include "mflib/MFMfr.hpp"
+#include "mflib/MFRegionIndex.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// reads of a source overlapping the regions, in file order
+// chr is used for sources without chromosome information
+static void query(methylFlow::MFReadSource &source, const methylFlow::MFRegionIndex &index,
+                  const std::vector<methylFlow::MFRegion> &regions, int chr,
+                  std::vector<std::string> &ids)
+{
+    methylFlow::MFRegionReadSource region_source(source, index, regions);
+    methylFlow::MethylRead *m;
+    std::string readid;
+    int res;
+    ids.clear();
+    while ((res = region_source.next(m, readid, chr)) > 0) {
+        ids.push_back(readid);
+        delete m;
+    }
+    assert(res == 0);
+}
+
+// same by scanning every read
+static void scan(methylFlow::MFReadSource &source, const std::vector<methylFlow::MFRegion> &regions,
+                 int chr, std::vector<std::string> &ids)
+{
+    methylFlow::MethylRead *m;
+    std::string readid;
+    ids.clear();
+    while (source.next(m, readid, chr) > 0) {
+        for (std::size_t k = 0; k < regions.size(); ++k) {
+            if (methylFlow::contig_number(regions[k].contig) == chr && m->start() <= regions[k].end && m->end() >= regions[k].start) {
+                ids.push_back(readid);
+                break;
+            }
+        }
+        delete m;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *tsv_filename = "test_regions.tsv";
+    const char *mfr_filename = "test_regions.mfr";
+    int res;
+    
+    methylFlow::MFRegion region;
+    res = methylFlow::parse_region("chr3:1,000-2000", region);
+    assert(res == 0);
+    assert(region.contig == "chr3" && region.start == 1000 && region.end == 2000);
+    res = methylFlow::parse_region("12", region);
+    assert(res == 0);
+    assert(region.contig == "12" && region.start == 1);
+    res = methylFlow::parse_region("chr3:2000-1000", region);
+    assert(res != 0);
+    res = methylFlow::parse_region("chr3:1000", region);
+    assert(res != 0);
+    
+    // sorted reads over 300kb, some long enough to span several windows
+    srand(42);
+    std::vector<methylFlow::MethylRead> reads;
+    std::vector<std::string> readids;
+    std::ofstream out(tsv_filename);
+    int pos = 1;
+    for (int i = 0; i < 5000; ++i) {
+        pos += rand() % 120;
+        int len = rand() % 50 == 0 ? 20000 + rand() % 20000 : 50 + rand() % 100;
+        char id[32];
+        sprintf(id, "read%d", i);
+        out << id << "\t" << pos << "\t" << len << "\tW\t2:M,6:U\t*\n";
+        reads.push_back(methylFlow::MethylRead(pos, len));
+        readids.push_back(id);
+    }
+    out.close();
+    
+    methylFlow::MFMappedTSVReadSource tsv_source;
+    res = tsv_source.open(tsv_filename);
+    assert(res == 0);
+    methylFlow::MFRegionIndex index;
+    res = index.build(tsv_source, 5);
+    assert(res == 0);
+    res = index.save("test_regions.tsv.mfi");
+    assert(res == 0);
+    methylFlow::MFRegionIndex loaded;
+    res = loaded.load("test_regions.tsv.mfi");
+    assert(res == 0);
+    assert(loaded.chr_rank(5) == 0 && loaded.chr_rank(1) == -1);
+    assert(loaded.find_contig("chr5") == 5 && loaded.find_contig("4") == -1);
+    
+    // random sets of regions, also overlapping and unsorted ones
+    std::vector<std::string> expected, found;
+    std::size_t total = 0;
+    for (int trial = 0; trial < 50; ++trial) {
+        std::vector<methylFlow::MFRegion> regions;
+        int nregions = 1 + rand() % 4;
+        for (int k = 0; k < nregions; ++k) {
+            region.contig = rand() % 10 == 0 ? "4" : rand() % 2 ? "chr5" : "5";
+            region.start = 1 + rand() % (pos + 1000);
+            region.end = region.start + rand() % 30000;
+            regions.push_back(region);
+        }
+        
+        res = tsv_source.open(tsv_filename);
+        assert(res == 0);
+        scan(tsv_source, regions, 5, expected);
+        query(tsv_source, loaded, regions, 5, found);
+        // regions are merged, reads come once and in file order
+        assert(found == expected);
+        total += found.size();
+        
+        // streamed tsv
+        std::ifstream in(tsv_filename);
+        methylFlow::MFStreamReadSource stream_source(in, false);
+        query(stream_source, loaded, regions, 5, found);
+        assert(found == expected);
+    }
+    
+    // mfr input with a new chromosome every 1000 reads
+    methylFlow::MFMfrWriter writer(256);
+    res = writer.open(mfr_filename);
+    assert(res == 0);
+    for (std::size_t i = 0; i < reads.size(); ++i) {
+        res = writer.write(reads[i], readids[i], 20 - i / 1000);
+        assert(res == 0);
+    }
+    res = writer.close();
+    assert(res == 0);
+    
+    methylFlow::MFMfrReadSource mfr_source;
+    res = mfr_source.open(mfr_filename);
+    assert(res == 0);
+    res = index.build(mfr_source, 0);
+    assert(res == 0);
+    assert(index.chr_rank(20) == 0 && index.chr_rank(16) == 4);
+    
+    for (int trial = 0; trial < 50; ++trial) {
+        std::vector<methylFlow::MFRegion> regions;
+        int nregions = 1 + rand() % 4;
+        for (int k = 0; k < nregions; ++k) {
+            std::ostringstream contig;
+            contig << "chr" << 16 + rand() % 6;
+            region.contig = contig.str();
+            region.start = 1 + rand() % (pos + 1000);
+            region.end = region.start + rand() % 30000;
+            regions.push_back(region);
+        }
+        
+        res = mfr_source.open(mfr_filename);
+        assert(res == 0);
+        scan(mfr_source, regions, 0, expected);
+        query(mfr_source, index, regions, 0, found);
+        assert(found == expected);
+        total += found.size();
+    }
+    assert(total > 0);
+    
+    // SAM regions are named by header contigs, the header is read
+    // before seeking past it
+    const char *sam_filename = "test_regions.sam";
+    const char *sam_fields = "255\t4M\t*\t0\t0\tACGT\tIIII\tNM:i:0\tXX:Z:4\tXM:Z:.Z..\tXR:Z:CT\tXG:Z:CT\n";
+    out.open(sam_filename);
+    out << "@HD\tVN:1.0\tSO:coordinate\n" << "@SQ\tSN:chr1\tLN:1000000\n" << "@SQ\tSN:chrX\tLN:1000000\n";
+    out << "r1\t0\tchr1\t100\t" << sam_fields << "r2\t0\tchrX\t100\t" << sam_fields;
+    out << "r3\t0\tchrX\t500000\t" << sam_fields;
+    out.close();
+    {
+        std::ifstream sam_in(sam_filename);
+        methylFlow::MFStreamReadSource sam_source(sam_in, true);
+        res = index.build(sam_source, 0);
+        assert(res == 0);
+        assert(index.find_contig("X") == 1);
+    }
+    std::ifstream sam_in(sam_filename);
+    methylFlow::MFStreamReadSource sam_source(sam_in, true);
+    std::vector<methylFlow::MFRegion> sam_regions;
+    res = methylFlow::parse_region("chrX:400000-600000", region);
+    assert(res == 0);
+    sam_regions.push_back(region);
+    query(sam_source, index, sam_regions, 0, found);
+    assert(found.size() == 1);
+    assert(sam_source.contigs()->size() == 2);
+    
+    // unsorted input can't be indexed
+    out.open(tsv_filename);
+    out << "read1\t100\t20\tW\t2:M\t*\n" << "read2\t50\t20\tW\t2:M\t*\n";
+    out.close();
+    res = tsv_source.open(tsv_filename);
+    assert(res == 0);
+    res = index.build(tsv_source, 1);
+    assert(res != 0);
+    
+    remove(tsv_filename);
+    remove(mfr_filename);
+    remove(sam_filename);
+    remove("test_regions.tsv.mfi");
+    std::cout << total << " region reads match" << std::endl;
+    return 0;
+}